@@ -0,0 +1,268 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <list>
+#include <map>
+#include <memory_resource>
+#include <numeric>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <lida/ConcurrentMemoryPool.hpp>
+#include <lida/MemoryPool.hpp>
+#include <lida/PmrPoolResource.hpp>
+
+/*
+ * Each allocator is described by a policy which makes containers using it.
+ * A policy object lives for one run of a benchmark, so pmr resources start
+ * every run empty.
+ */
+
+struct StdAllocator
+{
+	template<typename T>
+	using allocator = std::allocator<T>;
+
+	template<typename C>
+	C make()
+	{
+		return C();
+	}
+};
+
+struct PoolAllocator
+{
+	template<typename T>
+	using allocator = lida::MemoryPool<T>;
+
+	template<typename C>
+	C make()
+	{
+		return C();
+	}
+};
+
+struct ConcurrentPoolAllocator
+{
+	template<typename T>
+	using allocator = lida::ConcurrentMemoryPool<T>;
+
+	template<typename C>
+	C make()
+	{
+		return C();
+	}
+};
+
+template<typename Resource>
+struct PmrAllocator
+{
+	Resource resource;
+
+	template<typename T>
+	using allocator = std::pmr::polymorphic_allocator<T>;
+
+	template<typename C>
+	C make()
+	{
+		return C(&resource);
+	}
+};
+
+using StdPmrAllocator = PmrAllocator<std::pmr::unsynchronized_pool_resource>;
+using LidaPmrAllocator = PmrAllocator<lida::PmrPoolResource<>>;
+
+static std::vector<int> shuffled(std::size_t n)
+{
+	std::vector<int> keys(n);
+	std::iota(keys.begin(), keys.end(), 0);
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+	return keys;
+}
+
+/// Fill a list, erase every second node, then destroy it.
+template<typename Policy>
+static void list_insert_erase(benchmark::State& state)
+{
+	using List = std::list<int, typename Policy::template allocator<int>>;
+	auto n = static_cast<std::size_t>(state.range(0));
+	for (auto _ : state)
+	{
+		Policy policy;
+		auto list = policy.template make<List>();
+		for (std::size_t i = 0; i < n; i++)
+			list.push_back(int(i));
+		for (auto it = list.begin(); it != list.end(); it = list.erase(it))
+			++it;
+		benchmark::DoNotOptimize(list.size());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/// Insert random keys into a set and destroy it.
+template<typename Policy>
+static void set_insert_teardown(benchmark::State& state)
+{
+	using Set = std::set<int, std::less<int>, typename Policy::template allocator<int>>;
+	auto keys = shuffled(state.range(0));
+	for (auto _ : state)
+	{
+		Policy policy;
+		auto set = policy.template make<Set>();
+		for (auto key : keys)
+			set.insert(key);
+		benchmark::DoNotOptimize(set.size());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/// Insert random keys into a map and erase them in another random order.
+template<typename Policy>
+static void map_insert_erase(benchmark::State& state)
+{
+	using Value = std::pair<const int, int>;
+	using Map = std::map<int, int, std::less<int>, typename Policy::template allocator<Value>>;
+	auto keys = shuffled(state.range(0));
+	auto order = keys;
+	std::shuffle(order.begin(), order.end(), std::mt19937(7));
+	for (auto _ : state)
+	{
+		Policy policy;
+		auto map = policy.template make<Map>();
+		for (auto key : keys)
+			map.emplace(key, key);
+		for (auto key : order)
+			map.erase(key);
+		benchmark::DoNotOptimize(map.size());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0) * 2);
+}
+
+struct Node
+{
+	void* links[3];
+	int value;
+};
+
+/**
+ * Allocate nodes and free them in reverse (LIFO) or random order, which
+ * decides how scattered the free slots are for next allocations.
+ */
+template<typename Policy, bool Random>
+static void free_order(benchmark::State& state)
+{
+	using Allocator = typename Policy::template allocator<Node>;
+	using Traits = std::allocator_traits<Allocator>;
+	auto n = static_cast<std::size_t>(state.range(0));
+	std::vector<Node*> nodes(n);
+	// the order is computed once, so both variants only differ in it
+	std::vector<std::size_t> order(n);
+	std::iota(order.begin(), order.end(), std::size_t(0));
+	if constexpr (Random)
+		std::shuffle(order.begin(), order.end(), std::mt19937(42));
+	else
+		std::reverse(order.begin(), order.end());
+	Policy policy;
+	Allocator allocator = policy.template make<Allocator>();
+	for (auto _ : state)
+	{
+		for (auto& node : nodes)
+			node = Traits::allocate(allocator, 1);
+		for (auto i : order)
+			Traits::deallocate(allocator, nodes[i], 1);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/// Allocate and free batches of nodes on several threads.
+template<typename Policy>
+static void threaded_allocate_free(benchmark::State& state)
+{
+	using Allocator = typename Policy::template allocator<Node>;
+	using Traits = std::allocator_traits<Allocator>;
+	Allocator allocator;
+	std::vector<Node*> nodes(static_cast<std::size_t>(state.range(0)));
+	for (auto _ : state)
+	{
+		for (auto& node : nodes)
+			node = Traits::allocate(allocator, 1);
+		for (auto node : nodes)
+			Traits::deallocate(allocator, node, 1);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/**
+ * Allocate nodes from a pool which starts without chunks, optionally
+ * reserving memory for all of them first (not measured).
+ */
+template<bool Reserve>
+static void pool_cold_start(benchmark::State& state)
+{
+	auto n = static_cast<std::size_t>(state.range(0));
+	std::vector<Node*> nodes(n);
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		{
+			lida::MemoryPoolResource resource;
+			lida::MemoryPool<Node> pool(resource);
+			if constexpr (Reserve)
+				pool.reserve(n);
+			state.ResumeTiming();
+			for (auto& node : nodes)
+				node = pool.allocate(1);
+			benchmark::DoNotOptimize(nodes.data());
+			state.PauseTiming();
+		}
+		state.ResumeTiming();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+#define CONTAINER_BENCHMARK(name, policy)						\
+	BENCHMARK_TEMPLATE(name, policy)->RangeMultiplier(10)->Range(1000, 10000000) \
+	->Unit(benchmark::kMillisecond)
+
+#define CONTAINER_BENCHMARKS(name)								\
+	CONTAINER_BENCHMARK(name, StdAllocator);					\
+	CONTAINER_BENCHMARK(name, PoolAllocator);					\
+	CONTAINER_BENCHMARK(name, ConcurrentPoolAllocator);			\
+	CONTAINER_BENCHMARK(name, StdPmrAllocator);					\
+	CONTAINER_BENCHMARK(name, LidaPmrAllocator)
+
+CONTAINER_BENCHMARKS(list_insert_erase);
+CONTAINER_BENCHMARKS(set_insert_teardown);
+CONTAINER_BENCHMARKS(map_insert_erase);
+
+#define FREE_ORDER_BENCHMARKS(policy)									\
+	BENCHMARK_TEMPLATE(free_order, policy, false)->Range(1 << 10, 1 << 20); \
+	BENCHMARK_TEMPLATE(free_order, policy, true)->Range(1 << 10, 1 << 20)
+
+FREE_ORDER_BENCHMARKS(StdAllocator);
+FREE_ORDER_BENCHMARKS(PoolAllocator);
+FREE_ORDER_BENCHMARKS(StdPmrAllocator);
+
+BENCHMARK_TEMPLATE(threaded_allocate_free, StdAllocator)->Arg(1024)->ThreadRange(1, 16);
+BENCHMARK_TEMPLATE(threaded_allocate_free, ConcurrentPoolAllocator)->Arg(1024)->ThreadRange(1, 16);
+
+BENCHMARK_TEMPLATE(pool_cold_start, false)->RangeMultiplier(10)->Range(1000, 1000000);
+BENCHMARK_TEMPLATE(pool_cold_start, true)->RangeMultiplier(10)->Range(1000, 1000000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,231 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#  include <sys/syscall.h>
+#endif
+
+#include "MemoryPool.hpp"
+
+/*
+ * Chunk providers backed by POSIX `mmap`. Use them as `chunk_provider`
+ * of pool traits, see lida::NewChunkProvider for the interface.
+ */
+
+namespace lida
+{
+	/// How MmapChunkProvider uses huge pages.
+	enum class HugePages
+	{
+		/// Regular pages only.
+		none,
+		/// Ask for transparent huge pages with `madvise(MADV_HUGEPAGE)`.
+		transparent,
+		/// Map from the reserved huge page pool with `MAP_HUGETLB`,
+		/// `transparent` is used when the pool is empty.
+		hugetlb,
+	};
+
+	/// Size of a huge page on common hardware.
+	inline constexpr std::size_t huge_page_size = 2 * 1024 * 1024;
+
+	namespace detail
+	{
+		inline std::size_t page_size() noexcept
+		{
+			static const auto size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+			return size;
+		}
+
+		/**
+		 * @brief Map `size` bytes aligned by `align`.
+		 * @return nullptr on failure.
+		 */
+		inline void* map_aligned(std::size_t size, std::size_t align) noexcept
+		{
+			auto extra = (align > page_size()) ? align - page_size() : 0;
+			auto ptr = mmap(nullptr, size + extra, PROT_READ | PROT_WRITE,
+							MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (ptr == MAP_FAILED)
+				return nullptr;
+			if (extra == 0)
+				return ptr;
+			// unmap unaligned head and tail of the mapping
+			auto begin = reinterpret_cast<std::uintptr_t>(ptr);
+			auto aligned = (begin + align - 1) & ~(align - 1);
+			auto tail = extra - (aligned - begin);
+			if ((aligned != begin && munmap(ptr, aligned - begin) != 0) ||
+				(tail != 0 && munmap(reinterpret_cast<void*>(aligned + size), tail) != 0))
+			{
+				munmap(ptr, size + extra);
+				return nullptr;
+			}
+			return reinterpret_cast<void*>(aligned);
+		}
+
+#ifdef MAP_HUGETLB
+		/**
+		 * @brief Map `size` bytes from the huge page pool, the mapping is
+		 * aligned by lida::huge_page_size and `size` must be its multiple.
+		 * @detail Huge page mappings can only be unmapped by whole pages, so
+		 * they are never over-allocated and trimmed like map_aligned() does.
+		 * @return nullptr on failure.
+		 */
+		inline void* map_huge(std::size_t size) noexcept
+		{
+			auto ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+							MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			return ptr == MAP_FAILED ? nullptr : ptr;
+		}
+#endif
+	}
+
+	/**
+	 * @brief Chunk provider which maps chunks directly with `mmap`.
+	 * @detail Together with `chunk_size = lida::huge_page_size` every chunk
+	 * sits on a 2MB page, which reduces TLB misses of big pools.
+	 * @tparam Mode usage of huge pages for chunks of at least
+	 * lida::huge_page_size bytes.
+	 */
+	template<HugePages Mode = HugePages::transparent>
+	class MmapChunkProvider
+	{
+	public:
+		[[nodiscard]]
+		void* allocate(std::size_t size, std::size_t align)
+		{
+			void* ptr = nullptr;
+#ifdef MAP_HUGETLB
+			if constexpr (Mode == HugePages::hugetlb)
+				if (size % huge_page_size == 0 && align <= huge_page_size)
+					ptr = detail::map_huge(size);
+#endif
+			if (!ptr)
+			{
+				ptr = detail::map_aligned(size, align);
+				if (!ptr)
+					throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+				if (Mode != HugePages::none && size >= huge_page_size)
+					madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+			}
+			return ptr;
+		}
+
+		void deallocate(void* ptr, std::size_t size, std::size_t) noexcept
+		{
+			[[maybe_unused]] auto unmapped = munmap(ptr, size) == 0;
+			assert(unmapped && "MmapChunkProvider:: munmap failed");
+		}
+
+		/**
+		 * @brief Give pages which lie inside of `size` bytes from `ptr`
+		 * back to the system with `madvise(MADV_DONTNEED)`, the memory stays
+		 * mapped and reads as zeros.
+		 */
+		void discard(void* ptr, std::size_t size) noexcept
+		{
+			auto begin = reinterpret_cast<std::uintptr_t>(ptr);
+			auto first = (begin + detail::page_size() - 1) & ~(detail::page_size() - 1);
+			auto last = (begin + size) & ~(detail::page_size() - 1);
+			if (first < last)
+				madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+		}
+
+		/**
+		 * @brief Fault in pages which lie inside of `size` bytes from `ptr`
+		 * with `madvise(MADV_POPULATE_WRITE)`, contents of the memory
+		 * don't change.
+		 * @return false if the system doesn't support it (Linux before 5.14).
+		 */
+		bool populate(void* ptr, std::size_t size) noexcept
+		{
+#ifdef MADV_POPULATE_WRITE
+			auto begin = reinterpret_cast<std::uintptr_t>(ptr);
+			auto first = (begin + detail::page_size() - 1) & ~(detail::page_size() - 1);
+			auto last = (begin + size) & ~(detail::page_size() - 1);
+			return first >= last ||
+				madvise(reinterpret_cast<void*>(first), last - first, MADV_POPULATE_WRITE) == 0;
+#else
+			(void)ptr;
+			(void)size;
+			return false;
+#endif
+		}
+	};
+
+	/**
+	 * @brief Chunk provider which maps chunks with `mmap` and binds them
+	 * to a NUMA node.
+	 * @detail Binding is done with `mbind(MPOL_BIND)` before memory is
+	 * touched, it is best effort: if it fails (or on non-Linux systems)
+	 * pages are placed by the kernel's default policy.
+	 * @tparam Mode usage of huge pages, see MmapChunkProvider.
+	 */
+	template<HugePages Mode = HugePages::transparent>
+	class NumaChunkProvider : private MmapChunkProvider<Mode>
+	{
+	private:
+		int node;
+
+	public:
+		/**
+		 * @param node NUMA node to place memory on, `-1` keeps default policy.
+		 */
+		explicit NumaChunkProvider(int node = -1) noexcept
+			: node(node) {}
+
+		int numa_node() const noexcept
+		{
+			return node;
+		}
+
+		[[nodiscard]]
+		void* allocate(std::size_t size, std::size_t align)
+		{
+			auto ptr = MmapChunkProvider<Mode>::allocate(size, align);
+#if defined(__linux__) && defined(SYS_mbind)
+			constexpr unsigned long bits = 8 * sizeof(unsigned long);
+			constexpr int max_nodes = 1024;
+			if (node >= 0 && node < max_nodes)
+			{
+				unsigned long mask[max_nodes / bits] = {};
+				mask[node / bits] = 1ul << (node % bits);
+				constexpr int mpol_bind = 2;
+				syscall(SYS_mbind, ptr, size, mpol_bind, mask, max_nodes + 1, 0);
+			}
+#endif
+			return ptr;
+		}
+
+		void deallocate(void* ptr, std::size_t size, std::size_t align) noexcept
+		{
+			MmapChunkProvider<Mode>::deallocate(ptr, size, align);
+		}
+
+		using MmapChunkProvider<Mode>::discard;
+		using MmapChunkProvider<Mode>::populate;
+	};
+}
@@ -0,0 +1,156 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "MemoryPool.hpp"
+
+namespace lida
+{
+	/**
+	 * @brief Scope in which pools don't allocate from sparse chunks, so
+	 * objects relocated in it are packed into dense chunks.
+	 * @detail Chunks which hold objects but have no more than
+	 * `max_occupancy` of their slots used are evacuated: new objects are
+	 * allocated from other chunks, and an evacuated chunk is released as
+	 * soon as its last object is relocated. Evacuated chunks are used again
+	 * when the scope ends. Applies to storages of a lida::MemoryPoolResource,
+	 * to global storages of one group and traits of lida::MemoryPool or to
+	 * all global storages.
+	 * Storages in the scope must not be used by other threads while the
+	 * scope begins and ends, and a scope over all global storages affects
+	 * storages of every group.
+	 * @code
+	 * {
+	 *     lida::Compaction compaction(list.get_allocator(), 0.25);
+	 *     lida::relocate(list);
+	 * }
+	 * @endcode
+	 */
+	class Compaction
+	{
+	private:
+		MemoryPoolResource* resource = nullptr;
+		std::size_t group = 0;
+		// traits of global storages in the scope, nullptr for all storages
+		const void* traits = nullptr;
+		std::size_t count;
+
+	public:
+		/**
+		 * @brief Evacuate sparse chunks of all global storages.
+		 */
+		explicit Compaction(double max_occupancy = 0.5) noexcept
+			: count(detail::StorageHook::evacuate_all(max_occupancy)) {}
+		/**
+		 * @brief Evacuate sparse chunks of storages owned by `resource`.
+		 */
+		explicit Compaction(MemoryPoolResource& resource, double max_occupancy = 0.5) noexcept
+			: resource(&resource), count(resource.begin_evacuation(max_occupancy)) {}
+		/**
+		 * @brief Evacuate sparse chunks of the resource of `pool` or of
+		 * global storages with its group and traits.
+		 */
+		template<typename T, std::size_t G, typename Traits>
+		explicit Compaction(const MemoryPool<T, G, Traits>& pool, double max_occupancy = 0.5) noexcept
+			: resource(pool.pool_resource()), group(G), traits(&detail::traits_id<Traits>),
+			  count(resource ? resource->begin_evacuation(max_occupancy) :
+					detail::StorageHook::evacuate_all(max_occupancy, G, traits)) {}
+		~Compaction() noexcept
+		{
+			if (resource)
+				resource->end_evacuation();
+			else
+				detail::StorageHook::restore_all(group, traits);
+		}
+		Compaction(const Compaction&) = delete;
+		Compaction& operator=(const Compaction&) = delete;
+
+		/// Count of chunks evacuated when the scope began.
+		std::size_t evacuated_chunks() const noexcept
+		{
+			return count;
+		}
+	};
+
+	/**
+	 * @brief Move an object out of an evacuated chunk, the hook for
+	 * intrusive containers and other structures which point to objects.
+	 * @detail If `object` lies in a chunk evacuated by lida::Compaction it
+	 * is moved (or copied bytewise for trivially copyable types) to a new
+	 * slot and the old one is deallocated. The caller must update pointers
+	 * to the object.
+	 * @return new address of the object.
+	 */
+	template<typename T, std::size_t G, typename Traits>
+	T* relocate(MemoryPool<T, G, Traits>& pool, T* object)
+	{
+		if (!pool.is_evacuating(object))
+			return object;
+		auto moved = pool.allocate(1);
+		if constexpr (std::is_trivially_copyable_v<T>)
+			std::memcpy(static_cast<void*>(moved), object, sizeof(T));
+		else
+		{
+			try
+			{
+				new(moved) T(std::move(*object));
+			}
+			catch (...)
+			{
+				pool.deallocate(moved, 1);
+				throw;
+			}
+			object->~T();
+		}
+		pool.deallocate(object, 1);
+		return moved;
+	}
+
+	/**
+	 * @brief Move all elements of `list` to new nodes keeping their order.
+	 * @detail Inside of a lida::Compaction scope new nodes are allocated
+	 * from dense chunks and evacuated chunks get free. Iterators, pointers
+	 * and references to elements are invalidated.
+	 */
+	template<typename T, typename Allocator>
+	void relocate(std::list<T, Allocator>& list)
+	{
+		for (auto it = list.begin(); it != list.end();)
+		{
+			list.emplace(it, std::move(*it));
+			it = list.erase(it);
+		}
+	}
+
+	/**
+	 * @brief Relocate elements of `list` to dense chunks of its pool.
+	 * @return count of evacuated chunks.
+	 */
+	template<typename T, std::size_t G, typename Traits>
+	std::size_t compact(std::list<T, MemoryPool<T, G, Traits>>& list, double max_occupancy = 0.5)
+	{
+		Compaction compaction(list.get_allocator(), max_occupancy);
+		relocate(list);
+		return compaction.evacuated_chunks();
+	}
+}
@@ -0,0 +1,422 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <mutex>
+
+#include "MemoryPool.hpp"
+
+namespace lida
+{
+	namespace detail
+	{
+		/// Free object in a thread's cache.
+		struct FreeNode
+		{
+			FreeNode* next;
+		};
+
+		/// Slot alignment of `T` which is also enough to hold a FreeNode.
+		template<typename T, typename Traits>
+		constexpr std::size_t cached_align() noexcept
+		{
+			constexpr std::size_t align = slot_align<T, Traits>();
+			return (align > alignof(FreeNode)) ? align : alignof(FreeNode);
+		}
+
+		/// Slot size of `T` which is also big enough to hold a FreeNode.
+		template<typename T, typename Traits>
+		constexpr std::size_t cached_size() noexcept
+		{
+			constexpr std::size_t size = (sizeof(T) > sizeof(FreeNode)) ?
+				sizeof(T) : sizeof(FreeNode);
+			constexpr std::size_t align = cached_align<T, Traits>();
+			return (size + align - 1) / align * align;
+		}
+
+		/**
+		 * @brief PoolStorage shared by threads. It is accessed by batches of
+		 * objects so the lock is taken once per batch.
+		 * @detail Batches given back by threads go to a lock free stack of
+		 * remote frees with a single atomic operation. The stack is taken
+		 * whole by the next thread which needs objects.
+		 */
+		template<std::size_t ObjSize, std::size_t Align, typename Traits>
+		class CentralStorage
+		{
+		public:
+			using Storage = PoolStorage<ObjSize, Align, Traits>;
+
+		private:
+			std::atomic<FreeNode*> remote = nullptr;
+			std::mutex mutex;
+			Storage storage;
+
+		public:
+			CentralStorage() = default;
+			explicit CentralStorage(const typename Storage::Provider& provider)
+				: storage(provider) {}
+
+			/**
+			 * @brief Push list from `first` to `last` to the stack of
+			 * remote frees.
+			 */
+			void push_remote(FreeNode* first, FreeNode* last) noexcept
+			{
+				auto top = remote.load(std::memory_order_relaxed);
+				do
+					last->next = top;
+				while (!remote.compare_exchange_weak(top, first,
+													 std::memory_order_release,
+													 std::memory_order_relaxed));
+			}
+
+			/**
+			 * @brief Take all objects from the stack of remote frees.
+			 */
+			[[nodiscard]]
+			FreeNode* take_remote() noexcept
+			{
+				if (!remote.load(std::memory_order_relaxed))
+					return nullptr;
+				return remote.exchange(nullptr, std::memory_order_acquire);
+			}
+
+			/**
+			 * @brief Allocate `count` objects and link them in a list.
+			 */
+			[[nodiscard]]
+			FreeNode* allocate_batch(std::size_t count)
+			{
+				FreeNode* head = nullptr;
+				std::lock_guard lock(mutex);
+				try
+				{
+					for (std::size_t i = 0; i < count; i++)
+						head = new(storage.allocate()) FreeNode{head};
+				}
+				catch (...)
+				{
+					release(head);
+					throw;
+				}
+				return head;
+			}
+
+			/**
+			 * @brief Deallocate all objects from list started with `head`.
+			 */
+			void deallocate_batch(FreeNode* head) noexcept
+			{
+				std::lock_guard lock(mutex);
+				release(head);
+			}
+
+			void reserve(std::size_t numElements)
+			{
+				std::lock_guard lock(mutex);
+				storage.reserve(numElements);
+			}
+
+			void reserve(std::size_t numElements, std::size_t threads)
+			{
+				std::lock_guard lock(mutex);
+				storage.reserve(numElements, threads);
+			}
+
+			std::future<void> reserve_async(std::size_t numElements)
+			{
+				std::lock_guard lock(mutex);
+				return storage.reserve_async(numElements);
+			}
+
+			void shrink_to_fit() noexcept
+			{
+				auto head = take_remote();
+				std::lock_guard lock(mutex);
+				release(head);
+				storage.shrink_to_fit();
+			}
+
+			std::size_t trim(std::size_t bytes_to_keep) noexcept
+			{
+				auto head = take_remote();
+				std::lock_guard lock(mutex);
+				release(head);
+				return storage.trim(bytes_to_keep);
+			}
+
+			std::size_t release_free_memory() noexcept
+			{
+				auto head = take_remote();
+				std::lock_guard lock(mutex);
+				release(head);
+				return storage.release_free_memory();
+			}
+
+			/**
+			 * @brief Usage of the storage, objects cached by threads
+			 * count as live.
+			 */
+			PoolStatistics statistics()
+			{
+				std::lock_guard lock(mutex);
+				return storage.statistics();
+			}
+
+		private:
+			void release(FreeNode* head) noexcept
+			{
+				while (head)
+				{
+					auto next = head->next;
+					storage.deallocate(head);
+					head = next;
+				}
+			}
+		};
+
+		/**
+		 * @brief Per thread list of free objects. It is refilled from and
+		 * flushed to the central storage by `Traits::thread_cache_batch`
+		 * objects and it is flushed completely when the thread exits.
+		 * @detail Objects taken from the stack of remote frees are kept in
+		 * a separate uncounted list which is used up before a refill.
+		 */
+		template<std::size_t ObjSize, std::size_t Align, typename Traits>
+		class ThreadCache
+		{
+		private:
+			static constexpr std::size_t batch = Traits::thread_cache_batch;
+
+			CentralStorage<ObjSize, Align, Traits>& central;
+			FreeNode* head = nullptr;
+			std::size_t count = 0;
+			FreeNode* adopted = nullptr;
+
+		public:
+			explicit ThreadCache(CentralStorage<ObjSize, Align, Traits>& central) noexcept
+				: central(central) {}
+			~ThreadCache() noexcept
+			{
+				central.deallocate_batch(head);
+				central.deallocate_batch(adopted);
+			}
+			ThreadCache(const ThreadCache&) = delete;
+			ThreadCache& operator=(const ThreadCache&) = delete;
+
+			[[nodiscard]]
+			void* allocate()
+			{
+				if (head)
+				{
+					auto node = head;
+					head = node->next;
+					count--;
+					return node;
+				}
+				if (!adopted)
+					adopted = central.take_remote();
+				if (!adopted)
+				{
+					head = central.allocate_batch(batch);
+					count = batch;
+					return allocate();
+				}
+				auto node = adopted;
+				adopted = node->next;
+				return node;
+			}
+
+			void deallocate(void* ptr) noexcept
+			{
+				head = new(ptr) FreeNode{head};
+				count++;
+				if (count > 2 * batch)
+				{
+					// give the oldest half back, keep recently freed objects hot
+					auto last = head;
+					for (std::size_t i = 1; i < batch; i++)
+						last = last->next;
+					auto first = last->next;
+					last->next = nullptr;
+					count = batch;
+					last = first;
+					while (last->next)
+						last = last->next;
+					central.push_remote(first, last);
+				}
+			}
+		};
+
+		/// Calling thread's cache of pools with same storage key and group.
+		template<std::size_t ObjSize, std::size_t Align, typename Traits, typename Key, std::size_t G>
+		ThreadCache<ObjSize, Align, Traits>& thread_cache()
+		{
+			thread_local ThreadCache<ObjSize, Align, Traits> cache(
+				static_storage<CentralStorage<ObjSize, Align, Traits>, Key, G>());
+			return cache;
+		}
+	}
+
+	/**
+	 * @brief Thread safe version of lida::MemoryPool.
+	 * @detail Every thread allocates from and deallocates to its own cache
+	 * of free objects without any synchronization. Caches exchange objects
+	 * with a storage shared by all threads in batches of
+	 * `Traits::thread_cache_batch` objects, so an object can be deallocated
+	 * from any thread, not only from the one which allocated it. Giving
+	 * a batch back costs one atomic operation and takes no lock.
+	 * @tparam T allocating type.
+	 * @tparam G allocator's group, see lida::MemoryPool.
+	 * @tparam Traits tunables of the storage, see lida::DefaultPoolTraits.
+	 */
+	template<typename T, std::size_t G = 0, typename Traits = DefaultPoolTraits>
+	class ConcurrentMemoryPool
+	{
+	private:
+		static constexpr std::size_t size = detail::cached_size<T, Traits>();
+		static constexpr std::size_t align = detail::cached_align<T, Traits>();
+
+		using storage_key = detail::storage_key_t<T, Traits>;
+
+		static auto& get_central()
+		{
+			return detail::static_storage<detail::CentralStorage<size, align, Traits>,
+										  storage_key, G>();
+		}
+
+		static auto& get_cache()
+		{
+			return detail::thread_cache<size, align, Traits, storage_key, G>();
+		}
+
+	public:
+		static constexpr std::size_t group = G;
+		using value_type = T;
+		template<typename U>
+		struct rebind
+		{
+			using other = ConcurrentMemoryPool<U, G, Traits>;
+		};
+
+		ConcurrentMemoryPool() = default;
+		template<typename U>
+		ConcurrentMemoryPool(const ConcurrentMemoryPool<U, G, Traits>&) noexcept {}
+
+		/**
+		 * @brief Allocate an object from calling thread's cache.
+		 * @param size count of objects, arrays aren't pooled and come from
+		 * aligned `operator new`.
+		 */
+		[[nodiscard]]
+		static T* allocate(std::size_t size)
+		{
+			if (size != 1)
+			{
+				if (size > std::numeric_limits<std::size_t>::max() / sizeof(T))
+					throw std::bad_alloc();
+				return static_cast<T*>(::operator new(sizeof(T) * size, std::align_val_t{align}));
+			}
+			return reinterpret_cast<T*>(get_cache().allocate());
+		}
+
+		/**
+		 * @brief Deallocate an object to calling thread's cache.
+		 * @param size count of objects, same as passed to allocate().
+		 */
+		static void deallocate(T* ptr, std::size_t size)
+		{
+			if (size != 1)
+				::operator delete(ptr, std::align_val_t{align});
+			else
+				get_cache().deallocate(ptr);
+		}
+
+		/**
+		 * @brief Preallocate memory in the shared storage.
+		 * @param numElements minimal count of objects to preallocate.
+		 */
+		static void reserve(std::size_t numElements)
+		{
+			get_central().reserve(numElements);
+		}
+
+		/**
+		 * @brief Preallocate memory in the shared storage and fault in its
+		 * pages with `threads` threads, all hardware threads if 0.
+		 */
+		static void reserve(std::size_t numElements, std::size_t threads)
+		{
+			get_central().reserve(numElements, threads);
+		}
+
+		/**
+		 * @brief Preallocate memory in the shared storage and fault in its
+		 * pages in a background thread, see MemoryPool::reserve_async().
+		 */
+		[[nodiscard]]
+		static std::future<void> reserve_async(std::size_t numElements)
+		{
+			return get_central().reserve_async(numElements);
+		}
+
+		/**
+		 * @brief Release free chunks cached by the shared storage.
+		 */
+		static void shrink_to_fit() noexcept
+		{
+			get_central().shrink_to_fit();
+		}
+
+		/**
+		 * @brief Release free chunks cached by the shared storage until
+		 * they take no more than `bytes_to_keep` bytes.
+		 * @return count of released bytes.
+		 */
+		static std::size_t trim(std::size_t bytes_to_keep) noexcept
+		{
+			return get_central().trim(bytes_to_keep);
+		}
+
+		/**
+		 * @brief Usage of the shared storage, see lida::PoolStatistics.
+		 * @detail Objects in caches of threads count as live and calls
+		 * are counted for batches moved between caches and the storage.
+		 */
+		static PoolStatistics statistics()
+		{
+			return get_central().statistics();
+		}
+
+		/**
+		 * @brief Pools are equal when they have the same group and traits,
+		 * then they share storages.
+		 */
+		template<typename U, std::size_t H, typename UTraits>
+		constexpr bool operator==(const ConcurrentMemoryPool<U, H, UTraits>&) const noexcept
+			{
+				return G == H && std::is_same_v<Traits, UTraits>;
+			}
+		template<typename U, std::size_t H, typename UTraits>
+		constexpr bool operator!=(const ConcurrentMemoryPool<U, H, UTraits>& rhs) const noexcept
+			{
+				return !(*this == rhs);
+			}
+	};
+}
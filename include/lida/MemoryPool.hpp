@@ -15,101 +15,1900 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <future>
 #include <limits>
-#ifndef NDEBUG
-#  include <stdexcept>
-#endif
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
 #include <vector>
 
+#if defined(__SANITIZE_ADDRESS__)
+#  define LIDA_POOL_ASAN 1
+#elif defined(__has_feature)
+#  if __has_feature(address_sanitizer)
+#    define LIDA_POOL_ASAN 1
+#  endif
+#endif
+#ifdef LIDA_POOL_ASAN
+#  include <sanitizer/asan_interface.h>
+#endif
+
 namespace lida
 {
+	/**
+	 * @brief How chunks track their free slots, see
+	 * DefaultPoolTraits::chunk_engine.
+	 */
+	enum class ChunkEngine
+	{
+		/// Free slots are linked through their own memory.
+		free_list,
+		/// Free slots are marked in a bitmap in chunk's header.
+		bitmap,
+	};
+
+	/**
+	 * @brief Which chunk with free slots a storage allocates from, see
+	 * DefaultPoolTraits::chunk_policy.
+	 */
+	enum class ChunkPolicy
+	{
+		/// The chunk which an object was most recently freed to.
+		lifo,
+		/// The fullest chunk, judged by eighths of its capacity.
+		fullest,
+	};
+
+	/**
+	 * @brief Usage of pool's memory, see lida::MemoryPool::statistics().
+	 * @detail Counters of calls and the peak are only maintained if
+	 * `Traits::statistics` is set and are zero otherwise, the rest is
+	 * computed from chunks when statistics are requested.
+	 */
+	struct PoolStatistics
+	{
+		/// Count of objects allocated and not deallocated.
+		std::size_t live_objects = 0;
+		/// Maximal `live_objects` since the storage was created, summed over
+		/// storages when statistics of several storages are added.
+		std::size_t peak_objects = 0;
+		/// Count of objects requested and returned to the pool.
+		std::size_t allocations = 0;
+		std::size_t deallocations = 0;
+		/// Count of all chunks, partially filled ones and free cached ones.
+		std::size_t chunks = 0;
+		std::size_t partial_chunks = 0;
+		std::size_t free_chunks = 0;
+		/// Count of slots in chunks which hold objects.
+		std::size_t used_chunk_slots = 0;
+		/// Bytes requested from the chunk provider.
+		std::size_t bytes = 0;
+
+		/**
+		 * @brief Share of slots in chunks holding objects which are free,
+		 * 0 when objects are packed in as few chunks as possible.
+		 */
+		double fragmentation() const noexcept
+		{
+			return used_chunk_slots ?
+				1.0 - double(live_objects) / double(used_chunk_slots) : 0.0;
+		}
+
+		PoolStatistics& operator+=(const PoolStatistics& rhs) noexcept
+		{
+			live_objects += rhs.live_objects;
+			peak_objects += rhs.peak_objects;
+			allocations += rhs.allocations;
+			deallocations += rhs.deallocations;
+			chunks += rhs.chunks;
+			partial_chunks += rhs.partial_chunks;
+			free_chunks += rhs.free_chunks;
+			used_chunk_slots += rhs.used_chunk_slots;
+			bytes += rhs.bytes;
+			return *this;
+		}
+	};
+
 	namespace detail
 	{
-		template<std::size_t ObjSize>
-		class MemoryChunk
+		constexpr std::size_t ceil_pow2(std::size_t n) noexcept
 		{
+			std::size_t p = 1;
+			while (p < n)
+				p <<= 1;
+			return p;
+		}
+
+		/**
+		 * @brief Smallest unsigned type able to index `Slots` slots which can
+		 * also be stored inside of a slot of `ObjSize` bytes.
+		 */
+		template<std::size_t Slots, std::size_t ObjSize>
+		using chunk_index_t =
+			std::conditional_t<(Slots <= 0xFF || ObjSize < sizeof(uint16_t)), uint8_t,
+			std::conditional_t<(Slots <= 0xFFFF || ObjSize < sizeof(uint32_t)), uint16_t,
+			uint32_t>>;
+
+#ifdef NDEBUG
+		inline constexpr bool debug_checks = false;
+#else
+		inline constexpr bool debug_checks = true;
+#endif
+
+		/**
+		 * @brief Whether chunks validate pointers passed to them, in debug
+		 * builds and with DefaultPoolTraits::sanitize.
+		 */
+		template<typename Traits>
+		inline constexpr bool checks = debug_checks || Traits::sanitize;
+
+		/// Report misuse of a pool, kept out of line so checks stay cheap.
+		[[noreturn]]
+#if defined(__GNUC__) || defined(__clang__)
+		__attribute__((noinline, cold))
+#endif
+		inline void pool_error(const char* message)
+		{
+			throw std::runtime_error(message);
+		}
+
+		/// Byte which fills free slots in sanitize mode.
+		inline constexpr uint8_t canary = 0xDD;
+
+		inline void fill_canary(uint8_t* ptr, std::size_t size) noexcept
+		{
+			std::memset(ptr, canary, size);
+		}
+
+		inline bool check_canary(const uint8_t* ptr, std::size_t size) noexcept
+		{
+			for (std::size_t i = 0; i < size; i++)
+				if (ptr[i] != canary)
+					return false;
+			return true;
+		}
+
+		/// Make memory inaccessible under AddressSanitizer, no-op without it.
+		inline void poison_memory(const void* ptr, std::size_t size) noexcept
+		{
+#ifdef LIDA_POOL_ASAN
+			ASAN_POISON_MEMORY_REGION(ptr, size);
+#else
+			(void)ptr;
+			(void)size;
+#endif
+		}
+
+		inline void unpoison_memory(const void* ptr, std::size_t size) noexcept
+		{
+#ifdef LIDA_POOL_ASAN
+			ASAN_UNPOISON_MEMORY_REGION(ptr, size);
+#else
+			(void)ptr;
+			(void)size;
+#endif
+		}
+
+		/// Index of the lowest set bit of a nonzero `word`.
+		inline unsigned countr_zero(uint64_t word) noexcept
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			return static_cast<unsigned>(__builtin_ctzll(word));
+#else
+			unsigned n = 0;
+			while (!(word & 1))
+			{
+				word >>= 1;
+				n++;
+			}
+			return n;
+#endif
+		}
+
+		/**
+		 * @brief Bitmap of allocated slots which MemoryChunk keeps in
+		 * sanitize mode to detect double frees, empty otherwise.
+		 */
+		template<bool Enabled, std::size_t Slots>
+		struct LiveSlots
+		{
+			void allocated(std::size_t) noexcept {}
+			void freed(std::size_t) noexcept {}
+		};
+
+		template<std::size_t Slots>
+		struct LiveSlots<true, Slots>
+		{
+			uint64_t live[(Slots + 63) / 64] = {};
+
+			void allocated(std::size_t i) noexcept
+			{
+				live[i / 64] |= uint64_t(1) << (i % 64);
+			}
+			void freed(std::size_t i)
+			{
+				auto bit = uint64_t(1) << (i % 64);
+				if (!(live[i / 64] & bit))
+					pool_error("MemoryChunk:: double free");
+				live[i / 64] &= ~bit;
+			}
+		};
+
+		/**
+		 * @brief Block of slots which keeps its header at the beginning
+		 * of its own memory.
+		 * @detail Every chunk is aligned to its (power of two) size, so the chunk
+		 * which owns a slot is found by masking the slot's address. Memory of
+		 * chunks is managed by PoolStorage.
+		 * Slots are handed out in address order up to a watermark and only
+		 * freed slots are linked in the free list, so constructing a chunk
+		 * touches nothing but its header and slots that are never used are
+		 * never touched.
+		 * In sanitize mode free slots are filled with canaries, which are
+		 * checked when the slot is allocated again, and poisoned for
+		 * AddressSanitizer.
+		 * @tparam ObjSize size of a slot, multiple of `Align`.
+		 * @tparam Align alignment of every slot.
+		 * @tparam Traits supplies `chunk_size`, see lida::DefaultPoolTraits.
+		 */
+		template<std::size_t ObjSize, std::size_t Align, typename Traits>
+		class MemoryChunk : private LiveSlots<Traits::sanitize,
+											  // upper bound of capacity()
+											  2 * ceil_pow2(Traits::chunk_size) / ObjSize + 2>
+		{
+			static_assert(ObjSize % Align == 0, "MemoryChunk:: slot size must be multiple of its alignment");
+
 		private:
-			uint8_t* data;
-			uint8_t current;
-			uint8_t count;
+			static constexpr std::size_t bytes = ceil_pow2(Traits::chunk_size);
+			using index_type = chunk_index_t<bytes / ObjSize, ObjSize>;
 
-			static constexpr uint8_t max = std::numeric_limits<uint8_t>::max();
+			// head of the list of freed slots, capacity() if it's empty
+			index_type current;
+			// slots starting from this one have never been allocated
+			index_type fresh;
+			index_type count;
 
 		public:
+			/// Storage which the chunk belongs to, maintained by the pool.
+			void* owner = nullptr;
+			/// Whether the pool doesn't allocate from the chunk, see
+			/// PoolStorage::begin_evacuation().
+			bool evacuating = false;
+			/// Whether pages of the free chunk were given back to the system,
+			/// see PoolStorage::release_free_memory().
+			bool discarded = false;
+			/// Links in pool's list of all chunks.
+			MemoryChunk* all_prev = nullptr;
+			MemoryChunk* all_next = nullptr;
+			/// Links in pool's list of chunks which have free slots.
+			MemoryChunk* prev = nullptr;
+			MemoryChunk* next = nullptr;
+
 			MemoryChunk()
-				: current(0), count(max)
+				: current(capacity()), fresh(0), count(capacity())
 			{
-				data = new uint8_t[ObjSize * max];
-				for (std::size_t i = 0; i < max; i++)
-					data[i * ObjSize] = i + 1;
+				static_assert(capacity() <= 2 * bytes / ObjSize + 2);
+				if constexpr (Traits::sanitize)
+				{
+					fill_canary(data(), capacity() * ObjSize);
+					poison_memory(data(), capacity() * ObjSize);
+				}
 			}
 			~MemoryChunk() noexcept
 			{
-				if (data) delete[] data;
+				if constexpr (Traits::sanitize)
+					unpoison_memory(data(), capacity() * ObjSize);
 			}
 			MemoryChunk(const MemoryChunk&) = delete;
 			MemoryChunk& operator=(const MemoryChunk&) = delete;
-			MemoryChunk(MemoryChunk&& rhs) noexcept
-				: data(rhs.data), current(rhs.current), count(rhs.count)
+
+			/// Offset of the first slot from the beginning of the chunk.
+			static constexpr std::size_t header_size() noexcept
+			{
+				constexpr auto align = (Align > alignof(std::max_align_t)) ?
+					Align : alignof(std::max_align_t);
+				return (sizeof(MemoryChunk) + align - 1) / align * align;
+			}
+
+			/// Size and alignment of the memory block occupied by a chunk,
+			/// no bigger than needed for the slots `index_type` can address.
+			static constexpr std::size_t size() noexcept
+			{
+				constexpr std::size_t limit = std::numeric_limits<index_type>::max();
+				constexpr auto minimal = ceil_pow2(header_size() + ObjSize);
+				constexpr auto enough = ceil_pow2(header_size() + limit * ObjSize);
+				return (bytes < minimal) ? minimal : (bytes < enough) ? bytes : enough;
+			}
+
+			/// Count of slots in a chunk.
+			static constexpr std::size_t capacity() noexcept
+			{
+				constexpr std::size_t slots = (size() - header_size()) / ObjSize;
+				constexpr std::size_t limit = std::numeric_limits<index_type>::max();
+				return (slots < limit) ? slots : limit;
+			}
+
+			/// Find the chunk which owns the slot pointed by `ptr`.
+			static MemoryChunk* owner_of(void* ptr) noexcept
 			{
-				rhs.data = nullptr;
+				auto address = reinterpret_cast<std::uintptr_t>(ptr);
+				return reinterpret_cast<MemoryChunk*>(address & ~(size() - 1));
 			}
-			MemoryChunk& operator=(MemoryChunk&& rhs) noexcept 
-			{ 
-				this->~MemoryChunk();
-				new(this) MemoryChunk(std::move(rhs));
-				return *this;
+
+			[[nodiscard]]
+			void* allocate()
+			{
+				if (debug_checks && !has_space())
+					pool_error("MemoryChunk:: out of storage");
+				count--;
+				if (current == capacity())
+				{
+					auto ptr = data() + fresh++ * ObjSize;
+					take(ptr);
+					return ptr;
+				}
+				auto ptr = data() + current * ObjSize;
+				take(ptr);
+				current = load_link(ptr);
+				return ptr;
+			}
+
+			/**
+			 * @brief Allocate `n` objects, `n` must not be greater than
+			 * `free_count()`.
+			 */
+			void allocate_bulk(void** out, std::size_t n)
+			{
+				if (debug_checks && n > count)
+					pool_error("MemoryChunk:: out of storage");
+				auto slots = data();
+				count -= static_cast<index_type>(n);
+				std::size_t next = current;
+				for (; n != 0 && next != capacity(); n--)
+				{
+					auto ptr = slots + next * ObjSize;
+					take(ptr);
+					*out++ = ptr;
+					next = load_link(ptr);
+				}
+				current = static_cast<index_type>(next);
+				for (; n != 0; n--)
+				{
+					auto ptr = slots + fresh++ * ObjSize;
+					take(ptr);
+					*out++ = ptr;
+				}
+			}
+
+			void deallocate(void* ptr)
+			{
+				auto bptr = reinterpret_cast<uint8_t*>(ptr);
+				if (checks<Traits> && (!contains(ptr) || (bptr - data()) % ObjSize != 0))
+					pool_error("MemoryChunk:: passed invalid pointer to deallocate");
+				if constexpr (Traits::sanitize)
+				{
+					this->freed((bptr - data()) / ObjSize);
+					fill_canary(bptr, ObjSize);
+				}
+				store_link(bptr, current);
+				current = (bptr - data()) / ObjSize;
+				count++;
+				if constexpr (Traits::sanitize)
+					poison_memory(bptr, ObjSize);
+			}
+
+			/**
+			 * @brief Forget contents of free slots of a free chunk, used
+			 * after its memory was discarded.
+			 */
+			void reset() noexcept
+			{
+				current = static_cast<index_type>(capacity());
+				fresh = 0;
+				if constexpr (Traits::sanitize)
+				{
+					unpoison_memory(data(), capacity() * ObjSize);
+					fill_canary(data(), capacity() * ObjSize);
+					poison_memory(data(), capacity() * ObjSize);
+				}
+			}
+
+			bool has_space() const noexcept
+			{
+				return count != 0;
+			}
+
+			std::size_t free_count() const noexcept
+			{
+				return count;
+			}
+
+			bool contains(void* ptr) const noexcept
+			{
+				auto bptr = reinterpret_cast<const uint8_t*>(ptr);
+				return (bptr >= data()) && (bptr < data() + ObjSize * capacity());
+			}
+
+			bool is_free() const noexcept
+			{
+				return count == capacity();
+			}
+
+			/**
+			 * @brief Call `f(void*)` for each allocated slot in address order.
+			 * @detail Free slots are marked in a temporary bitmap by walking
+			 * the free list, sanitize mode uses its bitmap of live slots.
+			 */
+			template<typename F>
+			void for_each_allocated(F&& f) const
+			{
+				constexpr std::size_t words = (capacity() + 63) / 64;
+				if constexpr (Traits::sanitize)
+					visit_live(this->live, f);
+				else if constexpr (words <= 512)
+				{
+					uint64_t live[words];
+					mark_live(live);
+					visit_live(live, f);
+				}
+				else
+				{
+					std::vector<uint64_t> live(words);
+					mark_live(live.data());
+					visit_live(live.data(), f);
+				}
+			}
+
+		private:
+			uint8_t* data() noexcept
+			{
+				return reinterpret_cast<uint8_t*>(this) + header_size();
+			}
+			const uint8_t* data() const noexcept
+			{
+				return reinterpret_cast<const uint8_t*>(this) + header_size();
+			}
+
+			// set bits of slots below the watermark which aren't in the free list
+			void mark_live(uint64_t* live) const noexcept
+			{
+				for (std::size_t w = 0; w * 64 < fresh; w++)
+					live[w] = (fresh - w * 64 >= 64) ?
+						~uint64_t(0) : (uint64_t(1) << (fresh - w * 64)) - 1;
+				for (std::size_t i = current; i != capacity(); i = load_link(data() + i * ObjSize))
+					live[i / 64] &= ~(uint64_t(1) << (i % 64));
+			}
+
+			template<typename F>
+			void visit_live(const uint64_t* live, F& f) const
+			{
+				auto slots = const_cast<uint8_t*>(data());
+				for (std::size_t w = 0; w * 64 < fresh; w++)
+					for (auto word = live[w]; word; word &= word - 1)
+						f(static_cast<void*>(slots + (w * 64 + countr_zero(word)) * ObjSize));
+			}
+
+			// sanitize mode: make a free slot accessible and check that
+			// nothing but its link was written since it was freed
+			void take(uint8_t* slot)
+			{
+				if constexpr (Traits::sanitize)
+				{
+					unpoison_memory(slot, ObjSize);
+					if (!check_canary(slot + sizeof(index_type), ObjSize - sizeof(index_type)))
+						pool_error("MemoryChunk:: slot was modified after deallocation");
+					this->allocated((slot - data()) / ObjSize);
+				}
+			}
+
+			// slots are not necessarily aligned for index_type
+			static index_type load_link(const uint8_t* slot) noexcept
+			{
+				index_type link;
+				std::memcpy(&link, slot, sizeof(link));
+				return link;
+			}
+			static void store_link(uint8_t* slot, std::size_t link) noexcept
+			{
+				auto value = static_cast<index_type>(link);
+				std::memcpy(slot, &value, sizeof(value));
+			}
+		};
+
+		/**
+		 * @brief Chunk which tracks free slots in a bitmap kept in its header
+		 * instead of a free list threaded through the slots.
+		 * @detail Allocation finds a free slot with two bit scans, a summary
+		 * word selects a nonempty bitmap word, so it never loads memory of
+		 * free slots and slots may be smaller than a link. It has the same
+		 * interface as MemoryChunk and is selected by
+		 * `Traits::chunk_engine`. A chunk has at most 4096 slots. Sanitize
+		 * mode works as in MemoryChunk.
+		 */
+		template<std::size_t ObjSize, std::size_t Align, typename Traits>
+		class BitmapChunk
+		{
+			static_assert(ObjSize % Align == 0, "BitmapChunk:: slot size must be multiple of its alignment");
+
+		private:
+			static constexpr std::size_t bytes = ceil_pow2(Traits::chunk_size);
+			static constexpr std::size_t max_slots = (bytes / ObjSize < 64 * 64) ?
+				bytes / ObjSize : 64 * 64;
+			static constexpr std::size_t words_count = (max_slots > 64) ?
+				(max_slots + 63) / 64 : 1;
+
+			// bit `i` of `words[i / 64]` is set if slot `i` is free, bit `w` of
+			// `summary` is set if `words[w]` is nonzero
+			uint64_t summary = 0;
+			uint32_t count;
+			uint64_t words[words_count];
+
+		public:
+			/// Storage which the chunk belongs to, maintained by the pool.
+			void* owner = nullptr;
+			/// Whether the pool doesn't allocate from the chunk, see
+			/// PoolStorage::begin_evacuation().
+			bool evacuating = false;
+			/// Whether pages of the free chunk were given back to the system,
+			/// see PoolStorage::release_free_memory().
+			bool discarded = false;
+			/// Links in pool's list of all chunks.
+			BitmapChunk* all_prev = nullptr;
+			BitmapChunk* all_next = nullptr;
+			/// Links in pool's list of chunks which have free slots.
+			BitmapChunk* prev = nullptr;
+			BitmapChunk* next = nullptr;
+
+			BitmapChunk()
+				: count(capacity())
+			{
+				if constexpr (Traits::sanitize)
+				{
+					fill_canary(data(), capacity() * ObjSize);
+					poison_memory(data(), capacity() * ObjSize);
+				}
+				for (std::size_t w = 0; w < words_count; w++)
+				{
+					auto first = w * 64;
+					if (first + 64 <= capacity())
+						words[w] = ~uint64_t(0);
+					else if (first < capacity())
+						words[w] = (uint64_t(1) << (capacity() - first)) - 1;
+					else
+						words[w] = 0;
+					if (words[w])
+						summary |= uint64_t(1) << w;
+				}
+			}
+			~BitmapChunk() noexcept
+			{
+				if constexpr (Traits::sanitize)
+					unpoison_memory(data(), capacity() * ObjSize);
+			}
+			BitmapChunk(const BitmapChunk&) = delete;
+			BitmapChunk& operator=(const BitmapChunk&) = delete;
+
+			/// Offset of the first slot from the beginning of the chunk.
+			static constexpr std::size_t header_size() noexcept
+			{
+				constexpr auto align = (Align > alignof(std::max_align_t)) ?
+					Align : alignof(std::max_align_t);
+				return (sizeof(BitmapChunk) + align - 1) / align * align;
+			}
+
+			/// Size and alignment of the memory block occupied by a chunk,
+			/// no bigger than needed for the maximal count of slots.
+			static constexpr std::size_t size() noexcept
+			{
+				constexpr auto minimal = ceil_pow2(header_size() + ObjSize);
+				constexpr auto enough = ceil_pow2(header_size() + max_slots * ObjSize);
+				return (bytes < minimal) ? minimal : (bytes < enough) ? bytes : enough;
+			}
+
+			/// Count of slots in a chunk.
+			static constexpr std::size_t capacity() noexcept
+			{
+				constexpr std::size_t slots = (size() - header_size()) / ObjSize;
+				return (slots < words_count * 64) ? slots : words_count * 64;
+			}
+
+			/// Find the chunk which owns the slot pointed by `ptr`.
+			static BitmapChunk* owner_of(void* ptr) noexcept
+			{
+				auto address = reinterpret_cast<std::uintptr_t>(ptr);
+				return reinterpret_cast<BitmapChunk*>(address & ~(size() - 1));
+			}
+
+			[[nodiscard]]
+			void* allocate()
+			{
+				if (debug_checks && !has_space())
+					pool_error("BitmapChunk:: out of storage");
+				auto w = countr_zero(summary);
+				auto& word = words[w];
+				auto bit = countr_zero(word);
+				word &= word - 1;
+				if (!word)
+					summary &= ~(uint64_t(1) << w);
+				count--;
+				auto ptr = data() + (w * 64 + bit) * ObjSize;
+				take(ptr);
+				return ptr;
+			}
+
+			/**
+			 * @brief Allocate `n` objects, `n` must not be greater than
+			 * `free_count()`.
+			 */
+			void allocate_bulk(void** out, std::size_t n)
+			{
+				if (debug_checks && n > count)
+					pool_error("BitmapChunk:: out of storage");
+				count -= static_cast<uint32_t>(n);
+				while (n != 0)
+				{
+					auto w = countr_zero(summary);
+					auto& word = words[w];
+					for (; n != 0 && word; n--)
+					{
+						auto ptr = data() + (w * 64 + countr_zero(word)) * ObjSize;
+						take(ptr);
+						*out++ = ptr;
+						word &= word - 1;
+					}
+					if (!word)
+						summary &= ~(uint64_t(1) << w);
+				}
+			}
+
+			void deallocate(void* ptr)
+			{
+				auto bptr = reinterpret_cast<uint8_t*>(ptr);
+				if (checks<Traits> && (!contains(ptr) || (bptr - data()) % ObjSize != 0))
+					pool_error("BitmapChunk:: passed invalid pointer to deallocate");
+				std::size_t i = (bptr - data()) / ObjSize;
+				auto bit = uint64_t(1) << (i % 64);
+				if (checks<Traits> && (words[i / 64] & bit))
+					pool_error("BitmapChunk:: double free");
+				words[i / 64] |= bit;
+				summary |= uint64_t(1) << (i / 64);
+				count++;
+				if constexpr (Traits::sanitize)
+				{
+					fill_canary(bptr, ObjSize);
+					poison_memory(bptr, ObjSize);
+				}
+			}
+
+			/**
+			 * @brief Forget contents of free slots of a free chunk, used
+			 * after its memory was discarded.
+			 */
+			void reset() noexcept
+			{
+				if constexpr (Traits::sanitize)
+				{
+					unpoison_memory(data(), capacity() * ObjSize);
+					fill_canary(data(), capacity() * ObjSize);
+					poison_memory(data(), capacity() * ObjSize);
+				}
+			}
+
+			bool has_space() const noexcept
+			{
+				return count != 0;
+			}
+
+			std::size_t free_count() const noexcept
+			{
+				return count;
+			}
+
+			bool contains(void* ptr) const noexcept
+			{
+				auto bptr = reinterpret_cast<const uint8_t*>(ptr);
+				return (bptr >= data()) && (bptr < data() + ObjSize * capacity());
+			}
+
+			bool is_free() const noexcept
+			{
+				return count == capacity();
+			}
+
+			/**
+			 * @brief Call `f(void*)` for each allocated slot in address order.
+			 */
+			template<typename F>
+			void for_each_allocated(F&& f) const
+			{
+				auto slots = const_cast<uint8_t*>(data());
+				for (std::size_t w = 0; w * 64 < capacity(); w++)
+				{
+					auto word = ~words[w];
+					if (capacity() - w * 64 < 64)
+						word &= (uint64_t(1) << (capacity() - w * 64)) - 1;
+					for (; word; word &= word - 1)
+						f(static_cast<void*>(slots + (w * 64 + countr_zero(word)) * ObjSize));
+				}
+			}
+
+		private:
+			uint8_t* data() noexcept
+			{
+				return reinterpret_cast<uint8_t*>(this) + header_size();
+			}
+			const uint8_t* data() const noexcept
+			{
+				return reinterpret_cast<const uint8_t*>(this) + header_size();
+			}
+			// sanitize mode: make a free slot accessible and check that it
+			// wasn't written since it was freed
+			void take(uint8_t* slot)
+			{
+				if constexpr (Traits::sanitize)
+				{
+					unpoison_memory(slot, ObjSize);
+					if (!check_canary(slot, ObjSize))
+						pool_error("BitmapChunk:: slot was modified after deallocation");
+				}
+			}
+		};
+
+		/// Whether `Provider` has `discard(ptr, size)`, see MmapChunkProvider.
+		template<typename Provider, typename = void>
+		struct can_discard : std::false_type {};
+
+		template<typename Provider>
+		struct can_discard<Provider, std::void_t<decltype(
+			std::declval<Provider&>().discard(std::declval<void*>(), std::size_t()))>>
+			: std::true_type {};
+
+		/// Whether `Provider` has `populate(ptr, size)`, see MmapChunkProvider.
+		template<typename Provider, typename = void>
+		struct can_populate : std::false_type {};
+
+		template<typename Provider>
+		struct can_populate<Provider, std::void_t<decltype(
+			std::declval<Provider&>().populate(std::declval<void*>(), std::size_t()))>>
+			: std::true_type {};
+
+		/// Step of writes which fault in pages of a chunk, the smallest page size.
+		inline constexpr std::size_t prefault_stride = 4096;
+
+		/// Counters of PoolStatistics, empty if statistics are disabled.
+		template<bool Enabled>
+		struct StorageCounters
+		{
+			void count_allocations(std::size_t) noexcept {}
+			void count_deallocations(std::size_t) noexcept {}
+			void fill(PoolStatistics&) const noexcept {}
+		};
+
+		template<>
+		struct StorageCounters<true>
+		{
+			std::size_t allocations = 0;
+			std::size_t deallocations = 0;
+			std::size_t peak = 0;
+
+			void count_allocations(std::size_t n) noexcept
+			{
+				allocations += n;
+				if (allocations - deallocations > peak)
+					peak = allocations - deallocations;
+			}
+			void count_deallocations(std::size_t n) noexcept
+			{
+				deallocations += n;
+			}
+			void fill(PoolStatistics& stats) const noexcept
+			{
+				stats.allocations = allocations;
+				stats.deallocations = deallocations;
+				stats.peak_objects = peak;
+			}
+		};
+
+		/**
+		 * @brief Chunks of one object size together with the list of chunks
+		 * which have free slots, so allocation never scans full chunks.
+		 * @detail Up to `Traits::retained_chunks` chunks are kept in a cache
+		 * after becoming free in order to not release and request memory
+		 * again when a container oscillates around a chunk boundary.
+		 * Chunks with free slots are kept in bins by occupancy, there's one
+		 * bin unless `Traits::chunk_policy` is ChunkPolicy::fullest.
+		 * All chunks are linked in an intrusive list through their headers,
+		 * so adding or releasing a chunk is O(1) and never moves others.
+		 */
+		template<std::size_t ObjSize, std::size_t Align, typename Traits>
+		class PoolStorage : private StorageCounters<Traits::statistics>
+		{
+		public:
+			using Chunk = std::conditional_t<Traits::chunk_engine == ChunkEngine::bitmap,
+											 BitmapChunk<ObjSize, Align, Traits>,
+											 MemoryChunk<ObjSize, Align, Traits>>;
+			using Provider = typename Traits::chunk_provider;
+			using traits_type = Traits;
+
+		private:
+			static constexpr std::size_t bins =
+				(Traits::chunk_policy == ChunkPolicy::fullest) ? 8 : 1;
+			// bin of chunks without free slots, they aren't linked
+			static constexpr std::size_t full = bins;
+
+			Provider provider;
+			Chunk* chunks = nullptr;
+			std::size_t chunk_count = 0;
+			// fuller chunks are in lower bins, bit `i` is set if bin `i`
+			// is not empty
+			Chunk* partial[bins] = {};
+			unsigned nonempty = 0;
+			Chunk* evacuating = nullptr;
+			Chunk* empty = nullptr;
+			std::size_t empty_count = 0;
+
+		public:
+			PoolStorage() = default;
+			explicit PoolStorage(const Provider& provider)
+				: provider(provider) {}
+			~PoolStorage() noexcept
+			{
+				release();
+			}
+			PoolStorage(const PoolStorage&) = delete;
+			PoolStorage& operator=(const PoolStorage&) = delete;
+
+			/// Find the storage which owns the object pointed by `ptr`.
+			static PoolStorage* owner_of(void* ptr) noexcept
+			{
+				return static_cast<PoolStorage*>(Chunk::owner_of(ptr)->owner);
+			}
+
+			const Provider& chunk_provider() const noexcept
+			{
+				return provider;
+			}
+
+			[[nodiscard]]
+			void* allocate()
+			{
+				if (!nonempty)
+					link(acquire_chunk());
+				auto bin = top_bin();
+				auto chunk = partial[bin];
+				void* ptr = chunk->allocate();
+				allocated(chunk, bin);
+				this->count_allocations(1);
+				return ptr;
+			}
+
+			/**
+			 * @brief Allocate `n` objects taking whole runs of free slots
+			 * from each chunk.
+			 */
+			void allocate_bulk(void** out, std::size_t n)
+			{
+				std::size_t done = 0;
+				try
+				{
+					while (done < n)
+					{
+						if (!nonempty)
+							link(acquire_chunk());
+						auto bin = top_bin();
+						auto chunk = partial[bin];
+						auto run = std::min(n - done, chunk->free_count());
+						chunk->allocate_bulk(out + done, run);
+						allocated(chunk, bin);
+						this->count_allocations(run);
+						done += run;
+					}
+				}
+				catch (...)
+				{
+					deallocate_bulk(out, done);
+					throw;
+				}
+			}
+
+			void deallocate(void* ptr)
+			{
+				auto chunk = Chunk::owner_of(ptr);
+				auto bin = bin_of(chunk);
+				chunk->deallocate(ptr);
+				this->count_deallocations(1);
+				update(chunk, bin);
+			}
+
+			/**
+			 * @brief Deallocate `n` objects. Consecutive pointers from the
+			 * same chunk are returned to it at once.
+			 */
+			void deallocate_bulk(void* const* ptrs, std::size_t n)
+			{
+				for (std::size_t i = 0; i < n;)
+				{
+					auto chunk = Chunk::owner_of(ptrs[i]);
+					auto bin = bin_of(chunk);
+					do
+						chunk->deallocate(ptrs[i++]);
+					while (i < n && Chunk::owner_of(ptrs[i]) == chunk);
+					update(chunk, bin);
+				}
+				this->count_deallocations(n);
+			}
+
+			void reserve(std::size_t numElements)
+			{
+				constexpr auto max = Chunk::capacity();
+				std::size_t count = (numElements % max == 0) ?
+					numElements / max : numElements / max + 1;
+				while (chunk_count < count)
+					push_empty(push_chunk());
+			}
+
+			/**
+			 * @brief Preallocate chunks and fault in their pages before
+			 * returning, so first allocations don't page fault.
+			 * @param threads count of threads which fault in pages, all
+			 * hardware threads if 0.
+			 */
+			void reserve(std::size_t numElements, std::size_t threads)
+			{
+				auto created = reserve_chunks(numElements);
+				prefault(created, threads);
+			}
+
+			/**
+			 * @brief Preallocate chunks and fault in their pages in a
+			 * background thread.
+			 * @detail Chunks are made before returning and may be allocated
+			 * from right away. Pages are faulted in without changing their
+			 * contents if the chunk provider has `populate()` and the system
+			 * supports it, which is probed on the first chunk before
+			 * returning. Otherwise pages are faulted in before returning and
+			 * the future is ready. Chunks must not be released before the
+			 * future is ready.
+			 */
+			[[nodiscard]]
+			std::future<void> reserve_async(std::size_t numElements)
+			{
+				auto created = reserve_chunks(numElements);
+				if constexpr (can_populate<Provider>::value && !Traits::sanitize)
+				{
+					constexpr auto size = Chunk::size() - Chunk::header_size();
+					if (!created.empty() && provider.populate(slots_of(created.front()), size))
+						return std::async(std::launch::async, [this, created = std::move(created)]
+						{
+							for (std::size_t i = 1; i < created.size(); i++)
+								provider.populate(slots_of(created[i]), size);
+						});
+				}
+				// nothing to do in the background, touch pages here
+				prefault(created, 1);
+				std::promise<void> done;
+				done.set_value();
+				return done.get_future();
+			}
+
+			/**
+			 * @brief Release all chunks, objects allocated from them become
+			 * invalid.
+			 */
+			void release() noexcept
+			{
+				while (chunks)
+				{
+					auto chunk = chunks;
+					chunks = chunk->all_next;
+					destroy_chunk(chunk);
+				}
+				chunk_count = 0;
+				for (auto& head : partial)
+					head = nullptr;
+				nonempty = 0;
+				evacuating = nullptr;
+				empty = nullptr;
+				empty_count = 0;
+			}
+
+			/**
+			 * @brief Release cached free chunks until they take no more
+			 * than `bytes_to_keep` bytes.
+			 * @return count of released bytes.
+			 */
+			std::size_t trim(std::size_t bytes_to_keep) noexcept
+			{
+				std::size_t released = 0;
+				while (empty && cached_bytes() > bytes_to_keep)
+				{
+					pop_chunk(pop_empty());
+					released += Chunk::size();
+				}
+				return released;
+			}
+
+			/**
+			 * @brief Release all cached free chunks.
+			 */
+			void shrink_to_fit() noexcept
+			{
+				trim(0);
+			}
+
+			/**
+			 * @brief Give memory of cached free chunks back to the system.
+			 * @detail If the chunk provider has `discard()` the chunks are
+			 * kept and only their pages are discarded, otherwise the chunks
+			 * are released unless `Traits::fixed_capacity` is set. Chunks
+			 * discarded by an earlier call and not used since are skipped.
+			 * @return count of bytes given back.
+			 */
+			std::size_t release_free_memory() noexcept
+			{
+				if constexpr (can_discard<Provider>::value)
+				{
+					constexpr auto size = Chunk::size() - Chunk::header_size();
+					std::size_t released = 0;
+					for (auto chunk = empty; chunk; chunk = chunk->next)
+						if (!chunk->discarded)
+						{
+							provider.discard(slots_of(chunk), size);
+							chunk->reset();
+							chunk->discarded = true;
+							released += size;
+						}
+					return released;
+				}
+				else if constexpr (!Traits::fixed_capacity)
+					return trim(0);
+				else
+					return 0;
+			}
+
+			/// Bytes taken by cached free chunks.
+			std::size_t cached_bytes() const noexcept
+			{
+				return empty_count * Chunk::size();
+			}
+
+			/**
+			 * @brief Current usage of the storage, walks all its chunks.
+			 */
+			PoolStatistics statistics() const noexcept
+			{
+				PoolStatistics stats;
+				this->fill(stats);
+				stats.chunks = chunk_count;
+				stats.free_chunks = empty_count;
+				stats.used_chunk_slots = (chunk_count - empty_count) * Chunk::capacity();
+				stats.bytes = chunk_count * Chunk::size();
+				for (auto chunk = chunks; chunk; chunk = chunk->all_next)
+					stats.live_objects += Chunk::capacity() - chunk->free_count();
+				for (auto head : partial)
+					for (auto chunk = head; chunk; chunk = chunk->next)
+						if (!chunk->is_free())
+							stats.partial_chunks++;
+				for (auto chunk = evacuating; chunk; chunk = chunk->next)
+					stats.partial_chunks++;
+				return stats;
+			}
+
+			/**
+			 * @brief Call `f(Chunk&)` for each chunk which holds objects.
+			 */
+			template<typename F>
+			void for_each_chunk(F&& f) const
+			{
+				for (auto chunk = chunks; chunk; chunk = chunk->all_next)
+					if (!chunk->is_free())
+						f(*chunk);
+			}
+
+			/**
+			 * @brief Call `f(void*)` for each allocated object, chunk by chunk.
+			 */
+			template<typename F>
+			void for_each_allocated(F&& f) const
+			{
+				for_each_chunk([&](const Chunk& chunk) { chunk.for_each_allocated(f); });
+			}
+
+			/**
+			 * @brief Count of chunks holding objects which have no more than
+			 * `max_occupancy` (from 0 to 1) of their slots used.
+			 */
+			std::size_t sparse_chunks(double max_occupancy) const noexcept
+			{
+				std::size_t count = 0;
+				for (auto chunk = chunks; chunk; chunk = chunk->all_next)
+					if (!chunk->is_free() && is_sparse(chunk, max_occupancy))
+						count++;
+				return count;
+			}
+
+			/**
+			 * @brief Stop allocating from chunks which have no more than
+			 * `max_occupancy` of their slots used.
+			 * @detail Objects relocated while evacuation lasts go to denser
+			 * chunks, and an evacuated chunk is released or cached as soon
+			 * as it becomes free. Evacuation ends with end_evacuation().
+			 * @return count of evacuated chunks.
+			 */
+			std::size_t begin_evacuation(double max_occupancy) noexcept
+			{
+				std::size_t count = 0;
+				for (std::size_t bin = 0; bin < bins; bin++)
+					for (auto chunk = partial[bin]; chunk;)
+					{
+						auto next = chunk->next;
+						if (is_sparse(chunk, max_occupancy))
+						{
+							unlink(chunk, bin);
+							chunk->evacuating = true;
+							push_front(evacuating, chunk);
+							count++;
+						}
+						chunk = next;
+					}
+				return count;
+			}
+
+			/**
+			 * @brief Allocate from evacuated chunks again.
+			 */
+			void end_evacuation() noexcept
+			{
+				while (evacuating)
+				{
+					auto chunk = evacuating;
+					remove(evacuating, chunk);
+					chunk->evacuating = false;
+					link(chunk);
+				}
+			}
+
+			/// Whether `ptr` was allocated from an evacuated chunk.
+			static bool is_evacuating(const void* ptr) noexcept
+			{
+				return Chunk::owner_of(const_cast<void*>(ptr))->evacuating;
+			}
+
+		private:
+			static std::size_t bin_of(const Chunk* chunk) noexcept
+			{
+				if (!chunk->has_space())
+					return full;
+				if constexpr (bins == 1)
+					return 0;
+				else
+				{
+					auto used = Chunk::capacity() - chunk->free_count();
+					return bins - 1 - used * bins / Chunk::capacity();
+				}
+			}
+
+			std::size_t top_bin() const noexcept
+			{
+				if constexpr (bins == 1)
+					return 0;
+				else
+					return countr_zero(nonempty);
+			}
+
+			// move chunk to the right bin after allocation from bin `bin`
+			void allocated(Chunk* chunk, std::size_t bin) noexcept
+			{
+				auto now = bin_of(chunk);
+				if (now != bin)
+				{
+					unlink(chunk, bin);
+					if (now != full)
+						link(chunk);
+				}
+			}
+
+			static bool is_sparse(const Chunk* chunk, double max_occupancy) noexcept
+			{
+				auto used = Chunk::capacity() - chunk->free_count();
+				return used <= max_occupancy * Chunk::capacity();
+			}
+
+			// move chunk to the right list after deallocation, `bin` is
+			// the chunk's bin before it
+			void update(Chunk* chunk, std::size_t bin) noexcept
+			{
+				if (chunk->evacuating)
+				{
+					if (chunk->is_free())
+					{
+						remove(evacuating, chunk);
+						chunk->evacuating = false;
+						retire(chunk);
+					}
+				}
+				else if (chunk->is_free())
+				{
+					if (bin != full)
+						unlink(chunk, bin);
+					retire(chunk);
+				}
+				else if (bin == full)
+					link(chunk);
+				else if (Traits::chunk_policy == ChunkPolicy::lifo ?
+						 partial[bin] != chunk : bin_of(chunk) != bin)
+				{
+					unlink(chunk, bin);
+					link(chunk);
+				}
+			}
+
+			// cache a free chunk or release it
+			void retire(Chunk* chunk) noexcept
+			{
+				if (Traits::fixed_capacity || empty_count < Traits::retained_chunks)
+					push_empty(chunk);
+				else
+					pop_chunk(chunk);
+			}
+
+			// take a cached free chunk or make a new one
+			Chunk* acquire_chunk()
+			{
+				if (empty)
+					return pop_empty();
+				if constexpr (Traits::fixed_capacity)
+					Traits::on_exhausted();
+				return push_chunk();
+			}
+
+			std::vector<Chunk*> reserve_chunks(std::size_t numElements)
+			{
+				constexpr auto max = Chunk::capacity();
+				std::size_t count = (numElements % max == 0) ?
+					numElements / max : numElements / max + 1;
+				std::vector<Chunk*> created;
+				if (chunk_count < count)
+					created.reserve(count - chunk_count);
+				while (chunk_count < count)
+				{
+					auto chunk = push_chunk();
+					push_empty(chunk);
+					created.push_back(chunk);
+				}
+				return created;
+			}
+
+			static uint8_t* slots_of(Chunk* chunk) noexcept
+			{
+				return reinterpret_cast<uint8_t*>(chunk) + Chunk::header_size();
+			}
+
+			// nothing was allocated from `created` chunks yet, so their slots
+			// may be overwritten
+			void prefault(const std::vector<Chunk*>& created, std::size_t threads)
+			{
+				// sanitize mode has filled slots with canaries already
+				if constexpr (!Traits::sanitize)
+				{
+					if (threads == 0)
+						threads = std::max(std::thread::hardware_concurrency(), 1u);
+					threads = std::min(threads, created.size());
+					std::atomic<std::size_t> next{0};
+					auto work = [&]
+					{
+						for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < created.size();)
+							prefault_chunk(created[i]);
+					};
+					std::vector<std::thread> workers;
+					try
+					{
+						for (std::size_t i = 1; i < threads; i++)
+							workers.emplace_back(work);
+					}
+					catch (const std::system_error&)
+					{
+						// threads which were started and this one do the work
+					}
+					work();
+					for (auto& worker : workers)
+						worker.join();
+				}
+			}
+
+			void prefault_chunk(Chunk* chunk) noexcept
+			{
+				constexpr auto size = Chunk::size() - Chunk::header_size();
+				auto slots = slots_of(chunk);
+				if constexpr (can_populate<Provider>::value)
+					if (provider.populate(slots, size))
+						return;
+				for (std::size_t offset = 0; offset < size; offset += prefault_stride)
+					static_cast<volatile uint8_t*>(slots)[offset] = 0;
+			}
+
+			Chunk* push_chunk()
+			{
+				auto chunk = new(provider.allocate(Chunk::size(), Chunk::size())) Chunk;
+				chunk->owner = this;
+				chunk->all_next = chunks;
+				if (chunks)
+					chunks->all_prev = chunk;
+				chunks = chunk;
+				chunk_count++;
+				return chunk;
+			}
+
+			void pop_chunk(Chunk* chunk) noexcept
+			{
+				if (chunk->all_prev)
+					chunk->all_prev->all_next = chunk->all_next;
+				else
+					chunks = chunk->all_next;
+				if (chunk->all_next)
+					chunk->all_next->all_prev = chunk->all_prev;
+				chunk_count--;
+				destroy_chunk(chunk);
+			}
+
+			void destroy_chunk(Chunk* chunk) noexcept
+			{
+				chunk->~Chunk();
+				provider.deallocate(chunk, Chunk::size(), Chunk::size());
+			}
+
+			void push_empty(Chunk* chunk) noexcept
+			{
+				chunk->next = empty;
+				empty = chunk;
+				empty_count++;
+			}
+
+			Chunk* pop_empty() noexcept
+			{
+				auto chunk = empty;
+				empty = chunk->next;
+				empty_count--;
+				chunk->discarded = false;
+				return chunk;
+			}
+
+			static void push_front(Chunk*& head, Chunk* chunk) noexcept
+			{
+				chunk->prev = nullptr;
+				chunk->next = head;
+				if (head)
+					head->prev = chunk;
+				head = chunk;
+			}
+
+			static void remove(Chunk*& head, Chunk* chunk) noexcept
+			{
+				if (chunk->prev)
+					chunk->prev->next = chunk->next;
+				else
+					head = chunk->next;
+				if (chunk->next)
+					chunk->next->prev = chunk->prev;
+			}
+
+			// put chunk with free slots at the front of its bin
+			void link(Chunk* chunk) noexcept
+			{
+				auto bin = bin_of(chunk);
+				push_front(partial[bin], chunk);
+				nonempty |= 1u << bin;
+			}
+
+			void unlink(Chunk* chunk, std::size_t bin) noexcept
+			{
+				remove(partial[bin], chunk);
+				if (!partial[bin])
+					nonempty &= ~(1u << bin);
+			}
+		};
+
+		/// Storage key of pools which share storage between types.
+		template<std::size_t Size, std::size_t Align>
+		struct SizeClass {};
+
+		template<typename Storage, typename = void>
+		struct has_release_free_memory : std::false_type {};
+
+		template<typename Storage>
+		struct has_release_free_memory<Storage, std::void_t<decltype(
+			std::declval<Storage&>().release_free_memory())>>
+			: std::true_type {};
+
+		template<typename Storage, typename = void>
+		struct can_evacuate : std::false_type {};
+
+		template<typename Storage>
+		struct can_evacuate<Storage, std::void_t<decltype(
+			std::declval<Storage&>().begin_evacuation(0.0))>>
+			: std::true_type {};
+
+		/// Unique address for each traits type.
+		template<typename Traits>
+		inline constexpr char traits_id = 0;
+
+		/**
+		 * @brief Entry in the list of global storages, which is walked by
+		 * lida::release_free_memory() and lida::Compaction.
+		 * @detail Registered objects must have `release_free_memory()`
+		 * which returns the count of bytes given back, and may have
+		 * `begin_evacuation()` and `end_evacuation()` like PoolStorage
+		 * together with `traits_type`. Evacuation can be limited to
+		 * storages of one group and traits, nullptr `traits` means all
+		 * storages.
+		 */
+		class StorageHook
+		{
+		private:
+			StorageHook* prev = nullptr;
+			StorageHook* next = nullptr;
+			void* object;
+			std::size_t group;
+			const void* traits = nullptr;
+			std::size_t (*release)(void*) noexcept;
+			std::size_t (*evacuate)(void*, double) noexcept = nullptr;
+			void (*restore)(void*) noexcept = nullptr;
+
+			static std::mutex& mutex()
+			{
+				static std::mutex m;
+				return m;
+			}
+			static StorageHook*& head() noexcept
+			{
+				static StorageHook* h = nullptr;
+				return h;
+			}
+
+		public:
+			template<typename T>
+			StorageHook(T& object, std::size_t group)
+				: object(&object), group(group),
+				  release([](void* ptr) noexcept { return static_cast<T*>(ptr)->release_free_memory(); })
+			{
+				if constexpr (can_evacuate<T>::value)
+				{
+					traits = &traits_id<typename T::traits_type>;
+					evacuate = [](void* ptr, double max_occupancy) noexcept
+					{
+						return static_cast<T*>(ptr)->begin_evacuation(max_occupancy);
+					};
+					restore = [](void* ptr) noexcept { static_cast<T*>(ptr)->end_evacuation(); };
+				}
+				std::lock_guard lock(mutex());
+				next = head();
+				if (next)
+					next->prev = this;
+				head() = this;
 			}
-
-			[[nodiscard]]
-			void* allocate()
+			~StorageHook() noexcept
 			{
-#ifndef NDEBUG
-				if (!has_space())
-					throw std::runtime_error("MemoryChunk:: out of storage");
-#endif
-				void* ptr = data + current * ObjSize;
-				current = data[current * ObjSize];
-				count--;
-				return ptr;
+				std::lock_guard lock(mutex());
+				if (prev)
+					prev->next = next;
+				else
+					head() = next;
+				if (next)
+					next->prev = prev;
 			}
+			StorageHook(const StorageHook&) = delete;
+			StorageHook& operator=(const StorageHook&) = delete;
 
-			void deallocate(void* ptr)
+			static std::size_t release_all() noexcept
 			{
-#ifndef NDEBUG
-				if (!contains(ptr))
-					throw std::runtime_error("MemoryChunk:: passed invalid pointer to deallocate");
-#endif
-				auto bptr = reinterpret_cast<uint8_t*>(ptr);
-				*bptr = current;
-				current = (bptr - data) / ObjSize;
-				count++;
+				std::lock_guard lock(mutex());
+				std::size_t released = 0;
+				for (auto hook = head(); hook; hook = hook->next)
+					released += hook->release(hook->object);
+				return released;
 			}
 
-			bool has_space() const noexcept
+			static std::size_t evacuate_all(double max_occupancy, std::size_t group = 0,
+											const void* traits = nullptr) noexcept
 			{
-				return count != 0;
+				std::lock_guard lock(mutex());
+				std::size_t count = 0;
+				for (auto hook = head(); hook; hook = hook->next)
+					if (hook->evacuate && hook->matches(group, traits))
+						count += hook->evacuate(hook->object, max_occupancy);
+				return count;
 			}
 
-			bool contains(void* ptr) const noexcept
+			static void restore_all(std::size_t group = 0, const void* traits = nullptr) noexcept
 			{
-				auto bptr = reinterpret_cast<uint8_t*>(ptr);
-				return (bptr >= data) && (bptr < data + ObjSize * max);
+				std::lock_guard lock(mutex());
+				for (auto hook = head(); hook; hook = hook->next)
+					if (hook->restore && hook->matches(group, traits))
+						hook->restore(hook->object);
 			}
 
-			bool is_free() const noexcept
+		private:
+			bool matches(std::size_t group, const void* traits) const noexcept
 			{
-				return count == max;
+				return !traits || (this->group == group && this->traits == traits);
 			}
 		};
+
+		/// Static storage, registered in StorageHook's list if it supports it.
+		template<typename Storage, std::size_t G, bool Hooked = has_release_free_memory<Storage>::value>
+		struct StaticStorage
+		{
+			Storage storage;
+		};
+
+		template<typename Storage, std::size_t G>
+		struct StaticStorage<Storage, G, true>
+		{
+			Storage storage;
+			StorageHook hook{storage, G};
+		};
+
+		/**
+		 * @brief Storage shared by all pools with same `Key` and group.
+		 * @tparam Key allocating type or SizeClass if
+		 * `Traits::share_storage` is set.
+		 */
+		template<typename Storage, typename Key, std::size_t G>
+		Storage& static_storage()
+		{
+			static StaticStorage<Storage, G> holder;
+			return holder.storage;
+		}
+
+		/// Alignment of slots for `T`, see DefaultPoolTraits::slot_alignment.
+		template<typename T, typename Traits>
+		constexpr std::size_t slot_align() noexcept
+		{
+			return (Traits::slot_alignment > alignof(T)) ? Traits::slot_alignment : alignof(T);
+		}
+
+		/// Size of slots for `T`, it's `sizeof(T)` rounded up to slot_align().
+		template<typename T, typename Traits>
+		constexpr std::size_t slot_size() noexcept
+		{
+			constexpr auto align = slot_align<T, Traits>();
+			return (sizeof(T) + align - 1) / align * align;
+		}
+
+		template<typename T, typename Traits>
+		using storage_key_t = std::conditional_t<Traits::share_storage,
+												 SizeClass<sizeof(T), alignof(T)>, T>;
+
+		/// Unique address for each storage type, key and group.
+		template<typename Storage, typename Key, std::size_t G>
+		inline constexpr char storage_id = 0;
+
+		/// Storage key of arrays of `1 << K` objects with storage key `Key`.
+		template<typename Key, std::size_t K>
+		struct ArrayClass {};
+
+		/// Smallest `k` such that `n <= 1 << k`, saturates at the top bit.
+		constexpr std::size_t ceil_log2(std::size_t n) noexcept
+		{
+			std::size_t k = 0;
+			while (k < std::numeric_limits<std::size_t>::digits - 1 && (std::size_t(1) << k) < n)
+				k++;
+			return k;
+		}
+
+		/// Biggest `k` such that `1 << k <= n`, 0 for `n == 0`.
+		constexpr std::size_t floor_log2(std::size_t n) noexcept
+		{
+			std::size_t k = 0;
+			while ((n >> (k + 1)) != 0)
+				k++;
+			return k;
+		}
+	}
+
+	/// Size of a cache line on common hardware.
+	inline constexpr std::size_t cache_line_size = 64;
+
+	/**
+	 * @brief Chunk provider which gets memory from global `operator new`.
+	 * @detail Chunk providers supply memory of chunks to storages. Other
+	 * providers are in lida/ChunkProviders.hpp, a custom one must have the
+	 * same member functions and be default constructible.
+	 */
+	struct NewChunkProvider
+	{
+		/**
+		 * @brief Allocate `size` bytes aligned by `align`, throw
+		 * `std::bad_alloc` on failure.
+		 */
+		[[nodiscard]]
+		void* allocate(std::size_t size, std::size_t align)
+		{
+			return ::operator new(size, std::align_val_t{align});
+		}
+
+		/**
+		 * @brief Free memory returned by allocate() with same arguments.
+		 */
+		void deallocate(void* ptr, std::size_t size, std::size_t align) noexcept
+		{
+			::operator delete(ptr, size, std::align_val_t{align});
+		}
+	};
+
+	/**
+	 * @brief Give memory of cached free chunks of all global storages back
+	 * to the system, e.g. on a memory pressure notification.
+	 * @detail Pages of chunks from providers with `discard()` (like
+	 * lida::MmapChunkProvider) are discarded and the chunks are kept for
+	 * reuse, chunks of other providers are released. Storages of
+	 * lida::ConcurrentMemoryPool are locked, but lida::MemoryPool is not
+	 * thread safe, so no other thread may use it during the call. Storages
+	 * of lida::MemoryPoolResource are not affected.
+	 * @return count of bytes given back.
+	 */
+	inline std::size_t release_free_memory() noexcept
+	{
+		return detail::StorageHook::release_all();
 	}
 
+	/**
+	 * @brief Default tunables of lida::MemoryPool.
+	 * @detail Derive from this struct and hide members to change them:
+	 * @code
+	 * struct HugeChunks : lida::DefaultPoolTraits
+	 * {
+	 *     static constexpr std::size_t chunk_size = 2 * 1024 * 1024;
+	 * };
+	 * std::set<int, std::less<int>, lida::MemoryPool<int, 0, HugeChunks>> s;
+	 * @endcode
+	 */
+	struct DefaultPoolTraits
+	{
+		/**
+		 * Bytes of memory requested for a chunk of objects. Rounded up to
+		 * a power of two and to hold at least one object.
+		 */
+		static constexpr std::size_t chunk_size = 16 * 1024;
+		/**
+		 * Count of free chunks cached for reuse instead of being released.
+		 * Chunks preallocated by `reserve()` are cached regardless of it.
+		 */
+		static constexpr std::size_t retained_chunks = 1;
+		/**
+		 * Count of objects moved at once between a thread's cache and
+		 * the shared storage of lida::ConcurrentMemoryPool.
+		 */
+		static constexpr std::size_t thread_cache_batch = 64;
+		/**
+		 * If true, all types of equal size and alignment share chunks
+		 * instead of each type having its own (in each group).
+		 */
+		static constexpr bool share_storage = false;
+		/**
+		 * Minimal alignment of slots. Objects are always aligned at least
+		 * by `alignof(T)`, set it to lida::cache_line_size to prevent false
+		 * sharing between objects touched by different threads.
+		 */
+		static constexpr std::size_t slot_alignment = 0;
+		/**
+		 * Arrays are allocated from chunks of arrays of the next power of
+		 * two count of objects if they take no more than this count of
+		 * bytes. Bigger arrays are allocated by global `operator new`.
+		 */
+		static constexpr std::size_t max_array_bytes = 1024;
+		/**
+		 * Bookkeeping of free slots. ChunkEngine::free_list costs no memory
+		 * per slot, ChunkEngine::bitmap allocates without touching free slots,
+		 * which suits tiny objects. Bitmap chunks hold at most 4096 slots and
+		 * take no more memory than that needs, even if `chunk_size` is bigger.
+		 */
+		static constexpr ChunkEngine chunk_engine = ChunkEngine::free_list;
+		/**
+		 * Chunk to allocate from. ChunkPolicy::lifo keeps allocating from the
+		 * chunk objects were freed to most recently, which is hot in cache.
+		 * ChunkPolicy::fullest packs objects in as few chunks as possible,
+		 * so nodes of a container stay close and sparse chunks get free and
+		 * released sooner.
+		 */
+		static constexpr ChunkPolicy chunk_policy = ChunkPolicy::lifo;
+		/**
+		 * If true, storages never request or release chunks on their own:
+		 * chunks are made by `reserve()`, kept when they become free, and
+		 * on_exhausted() is called when all of them are full. Allocation and
+		 * deallocation then take a bounded number of steps.
+		 */
+		static constexpr bool fixed_capacity = false;
+		/**
+		 * Called when a storage with `fixed_capacity` has no free slots.
+		 * Throws `std::bad_alloc` by default. If it returns, the storage
+		 * requests a new chunk.
+		 */
+		static void on_exhausted()
+		{
+			throw std::bad_alloc();
+		}
+		/**
+		 * If true, chunks check every pointer passed to them even in release
+		 * builds, detect double frees, fill free slots with canaries which
+		 * must be intact when the slot is allocated again, and poison free
+		 * slots when the program is built with AddressSanitizer. Objects in
+		 * thread caches of concurrent pools are only checked when they go
+		 * back to the shared storage.
+		 */
+		static constexpr bool sanitize = false;
+		/**
+		 * If true, storages count allocations, deallocations and the peak
+		 * count of objects for lida::PoolStatistics.
+		 */
+		static constexpr bool statistics = false;
+		/**
+		 * Bits of a lida::ObjectPool handle which hold the generation of its
+		 * slot, the rest is the index of the slot.
+		 */
+		static constexpr std::size_t handle_generation_bits = 8;
+		/**
+		 * Source of chunks' memory, see lida::NewChunkProvider.
+		 */
+		using chunk_provider = NewChunkProvider;
+	};
+
+	/**
+	 * @brief Owner of storages for lida::MemoryPool instances constructed
+	 * from it, which makes a pool local to a subsystem instead of global.
+	 * @detail All memory is released at once when the resource is destroyed
+	 * or release() is called, without deallocating objects one by one.
+	 * Allocators are equal only if they use the same resource. The resource
+	 * must outlive all allocators using it.
+	 * @code
+	 * lida::MemoryPoolResource resource;
+	 * std::list<int, lida::MemoryPool<int>> l{lida::MemoryPool<int>(resource)};
+	 * @endcode
+	 */
+	class MemoryPoolResource
+	{
+	private:
+		struct Entry
+		{
+			const void* key;
+			void* storage;
+			void (*clear)(void*) noexcept;
+			void (*destroy)(void*) noexcept;
+			std::size_t (*evacuate)(void*, double) noexcept;
+			void (*restore)(void*) noexcept;
+		};
+
+		std::vector<Entry> entries;
+
+	public:
+		MemoryPoolResource() = default;
+		~MemoryPoolResource() noexcept
+		{
+			for (auto& entry : entries)
+				entry.destroy(entry.storage);
+		}
+		MemoryPoolResource(const MemoryPoolResource&) = delete;
+		MemoryPoolResource& operator=(const MemoryPoolResource&) = delete;
+
+		/**
+		 * @brief Release memory of all objects allocated from the resource.
+		 * @detail Objects can't be deallocated after this but the resource
+		 * and its allocators can be used for new allocations. Storages stay
+		 * until the resource is destroyed, so allocators keep pointers to
+		 * them.
+		 */
+		void release() noexcept
+		{
+			for (auto& entry : entries)
+				entry.clear(entry.storage);
+		}
+
+		/**
+		 * @brief Storage which the resource owns for `Key` and group `G`,
+		 * it is created on first use.
+		 */
+		template<typename Storage, typename Key, std::size_t G>
+		Storage& get()
+		{
+			if (auto storage = find<Storage, Key, G>())
+				return *storage;
+			entries.reserve(entries.size() + 1);
+			auto storage = new Storage;
+			entries.push_back({&detail::storage_id<Storage, Key, G>, storage,
+							   [](void* ptr) noexcept { static_cast<Storage*>(ptr)->release(); },
+							   [](void* ptr) noexcept { delete static_cast<Storage*>(ptr); },
+							   [](void* ptr, double max_occupancy) noexcept
+							   {
+								   return static_cast<Storage*>(ptr)->begin_evacuation(max_occupancy);
+							   },
+							   [](void* ptr) noexcept { static_cast<Storage*>(ptr)->end_evacuation(); }});
+			return *storage;
+		}
+
+		/**
+		 * @brief Stop allocating from sparse chunks of all storages of the
+		 * resource, see lida::Compaction.
+		 * @return count of evacuated chunks.
+		 */
+		std::size_t begin_evacuation(double max_occupancy) noexcept
+		{
+			std::size_t count = 0;
+			for (auto& entry : entries)
+				count += entry.evacuate(entry.storage, max_occupancy);
+			return count;
+		}
+
+		void end_evacuation() noexcept
+		{
+			for (auto& entry : entries)
+				entry.restore(entry.storage);
+		}
+
+		/**
+		 * @brief Storage which the resource owns for `Key` and group `G`
+		 * or nullptr if it was not created.
+		 */
+		template<typename Storage, typename Key, std::size_t G>
+		Storage* find() const noexcept
+		{
+			for (auto& entry : entries)
+				if (entry.key == &detail::storage_id<Storage, Key, G>)
+					return static_cast<Storage*>(entry.storage);
+			return nullptr;
+		}
+	};
+
+	/**
+	 * @brief Objects of one chunk of a lida::MemoryPool, see
+	 * MemoryPool::chunk_spans().
+	 * @detail Chunks don't share memory, so different threads may visit
+	 * different spans at once as long as nothing allocates from or
+	 * deallocates to the pool meanwhile.
+	 */
+	template<typename T, typename Chunk>
+	class ChunkSpan
+	{
+	private:
+		const Chunk* chunk;
+
+	public:
+		explicit ChunkSpan(const Chunk& chunk) noexcept
+			: chunk(&chunk) {}
+
+		/// Count of objects in the chunk.
+		std::size_t size() const noexcept
+		{
+			return Chunk::capacity() - chunk->free_count();
+		}
+
+		/**
+		 * @brief Call `f(T&)` for each object of the chunk in address order.
+		 */
+		template<typename F>
+		void for_each_live(F&& f) const
+		{
+			chunk->for_each_allocated([&](void* ptr) { f(*reinterpret_cast<T*>(ptr)); });
+		}
+	};
+
 	/**
 	 * @brief STL compatible allocator which allocates and deallocates
 	 * single objects fast. This allocator shares memory between instances.
 	 * @detail Use this allocator with containers that live short and
-	 * allocate thousands of objects.
+	 * allocate thousands of objects. Small arrays are pooled too
+	 * (see DefaultPoolTraits::max_array_bytes), so the allocator also
+	 * works with containers like `std::vector` and `std::deque`.
+	 * Allocators constructed from lida::MemoryPoolResource use storage
+	 * owned by the resource instead.
 	 * The allocator is not thread safe(for performance reason) so in
 	 * multithreaded program use groups if you have many containers which use
 	 * the same allocator or mutexes otherwise.
@@ -117,92 +1916,339 @@ namespace lida
 	 * @tparam G allocator's group use different storages on same type.
 	 * It can be useful when you more than one performance critical threads
 	 * which allocate objects of the same type.
+	 * @tparam Traits tunables of the storage, see lida::DefaultPoolTraits.
 	 */
-	template<typename T, std::size_t G = 0>
+	template<typename T, std::size_t G = 0, typename Traits = DefaultPoolTraits>
 	class MemoryPool
 	{
 	private:
-		static auto& get_chunks()
+		template<typename, std::size_t, typename>
+		friend class MemoryPool;
+
+		static constexpr std::size_t slot_size = detail::slot_size<T, Traits>();
+		static constexpr std::size_t slot_align = detail::slot_align<T, Traits>();
+		/// Count of storages for arrays, arrays of `1 << K` objects go to K-th one.
+		static constexpr std::size_t array_classes =
+			detail::floor_log2(Traits::max_array_bytes / slot_size);
+
+		/// Storage for arrays of `1 << K` objects, single objects for `K == 0`.
+		template<std::size_t K>
+		using storage_type = detail::PoolStorage<(slot_size << K), slot_align, Traits>;
+
+		template<std::size_t K>
+		using storage_key = std::conditional_t<K == 0, detail::storage_key_t<T, Traits>,
+											   detail::ArrayClass<detail::storage_key_t<T, Traits>, K>>;
+
+		template<std::size_t K = 0>
+		static auto& get_storage()
+		{
+			return detail::static_storage<storage_type<K>, storage_key<K>, G>();
+		}
+
+		MemoryPoolResource* resource = nullptr;
+		/// Storage of single objects, looked up in the resource on first use.
+		mutable storage_type<0>* single = nullptr;
+
+		template<std::size_t K>
+		auto& storage() const
+		{
+			if (resource)
+				return resource->get<storage_type<K>, storage_key<K>, G>();
+			return get_storage<K>();
+		}
+
+		auto& single_storage() const
+		{
+			if (!single)
+				single = &storage<0>();
+			return *single;
+		}
+
+		/// Call `f` for each storage of this pool which exists.
+		template<typename F, std::size_t K = 0>
+		void for_each_storage(F&& f) const
+		{
+			if constexpr (K <= array_classes)
+			{
+				if (!resource)
+					f(get_storage<K>());
+				else if (auto s = resource->find<storage_type<K>, storage_key<K>, G>())
+					f(*s);
+				for_each_storage<F, K + 1>(std::forward<F>(f));
+			}
+		}
+
+		template<std::size_t K = 1>
+		void* allocate_array(std::size_t k, std::size_t size)
+		{
+			if constexpr (K > array_classes)
+			{
+				// not pooled, so not rounded up to a power of two
+				if (size > std::numeric_limits<std::size_t>::max() / sizeof(T))
+					throw std::bad_alloc();
+				return ::operator new(sizeof(T) * size, std::align_val_t{slot_align});
+			}
+			else if (k == K)
+				return storage<K>().allocate();
+			else
+				return allocate_array<K + 1>(k, size);
+		}
+
+		template<std::size_t K = 1>
+		void reserve_array(std::size_t k, std::size_t numArrays)
+		{
+			if constexpr (K <= array_classes)
+			{
+				if (k == K)
+					storage<K>().reserve(numArrays);
+				else
+					reserve_array<K + 1>(k, numArrays);
+			}
+		}
+
+		template<std::size_t K = 1>
+		void deallocate_array(void* ptr, std::size_t k)
 		{
-			static std::vector<detail::MemoryChunk<sizeof(T)>> chunks;
-			return chunks;
+			if constexpr (K > array_classes)
+				::operator delete(ptr, std::align_val_t{slot_align});
+			else if (k == K)
+				storage<K>().deallocate(ptr);
+			else
+				deallocate_array<K + 1>(ptr, k);
 		}
 
 	public:
 		static constexpr std::size_t group = G;
 		using value_type = T;
+		using chunk_span = ChunkSpan<T, typename storage_type<0>::Chunk>;
 		template<typename U>
 		struct rebind
 		{
-			using other = MemoryPool<U>;
+			using other = MemoryPool<U, G, Traits>;
 		};
 
-		MemoryPool() = default;
+		/**
+		 * @brief Create allocator which uses storage shared by all
+		 * default constructed allocators of this type.
+		 */
+		MemoryPool() noexcept
+			: single(&get_storage()) {}
+		/**
+		 * @brief Create allocator which uses storage owned by `resource`.
+		 */
+		MemoryPool(MemoryPoolResource& resource) noexcept
+			: resource(&resource) {}
+		MemoryPool(const MemoryPool&) noexcept = default;
 		template<typename U>
-		MemoryPool(const MemoryPool<U>&) noexcept {}
+		MemoryPool(const MemoryPool<U, G, Traits>& rhs) noexcept
+			: resource(rhs.resource), single(resource ? nullptr : &get_storage()) {}
+		MemoryPool& operator=(const MemoryPool&) noexcept = default;
 
 		/**
-		 * @brief Allocate an object from shared storage.
-		 * @param size made for compability with std::allocator_traits.
-		 * passing `size != 1` is undefined behaviour.
+		 * @brief Allocate an object or an array of objects.
+		 * @param size count of objects.
 		 */
 		[[nodiscard]]
-		static T* allocate([[maybe_unused]] std::size_t size)
+		T* allocate(std::size_t size)
 		{
-			auto& chunks = get_chunks();
-#ifndef NDEBUG
-			if (size != 1)
-				throw std::runtime_error("MemoryPool is only able for allocating single objects");
-#endif
-			for (auto& chunk : chunks)
-				if (chunk.has_space())
-					return reinterpret_cast<T*>(chunk.allocate());
-			chunks.emplace_back();
-			return reinterpret_cast<T*>(chunks.back().allocate());
+			if (size <= 1)
+				return reinterpret_cast<T*>(single_storage().allocate());
+			return reinterpret_cast<T*>(allocate_array(detail::ceil_log2(size), size));
 		}
 
 		/**
-		 * @brief Deallocate an object from shared storage.
-		 * @param size made for compability with std::allocator_traits.
-		 * passing `size != 1` is undefined behaviour.
+		 * @brief Deallocate an object or an array of objects.
+		 * @param size count of objects, same as passed to allocate().
 		 */
-		static void deallocate(T* ptr, [[maybe_unused]] std::size_t size)
+		void deallocate(T* ptr, std::size_t size)
 		{
-			auto& chunks = get_chunks();
-			for (auto it = chunks.begin(); it != chunks.end(); ++it)
-			{
-				auto& chunk = *it;
-				if (chunk.contains(ptr))
-				{
-					chunk.deallocate(ptr);
-					if (chunk.is_free()) 
-						chunks.erase(it);
-					return;
-				}
-			}
+			if (size <= 1)
+				single_storage().deallocate(ptr);
+			else
+				deallocate_array(ptr, detail::ceil_log2(size));
+		}
+
+		/**
+		 * @brief Allocate `n` objects at once.
+		 * @param out array of at least `n` pointers to write objects to.
+		 */
+		void allocate_bulk(T** out, std::size_t n)
+		{
+			single_storage().allocate_bulk(reinterpret_cast<void**>(out), n);
+		}
+
+		/**
+		 * @brief Deallocate `n` objects at once.
+		 * @detail Cheaper when pointers from the same chunk are adjacent
+		 * in `ptrs`, e.g. when they were allocated by allocate_bulk().
+		 * @param ptrs array of `n` objects to deallocate.
+		 */
+		void deallocate_bulk(T* const* ptrs, std::size_t n)
+		{
+			single_storage().deallocate_bulk(reinterpret_cast<void* const*>(ptrs), n);
 		}
 
 		/**
 		 * @brief Preallocate memory.
+		 * @detail Only headers of new chunks are written, so with a chunk
+		 * provider which maps memory lazily (see lida::MmapChunkProvider)
+		 * this reserves address space and pages are faulted in on first use.
 		 * @param numElements minimal count of objects to preallocate.
 		 */
-		static void reserve(std::size_t numElements)
+		void reserve(std::size_t numElements)
+		{
+			single_storage().reserve(numElements);
+		}
+
+		/**
+		 * @brief Preallocate memory for `numArrays` arrays of `size` objects.
+		 * @detail Arrays of sizes which round up to the same power of two
+		 * share a storage, arrays bigger than `Traits::max_array_bytes`
+		 * aren't pooled and nothing is reserved for them. With
+		 * `Traits::fixed_capacity` every array size which is allocated needs
+		 * to be reserved.
+		 */
+		void reserve_arrays(std::size_t size, std::size_t numArrays)
+		{
+			if (size <= 1)
+				reserve(numArrays);
+			else
+				reserve_array(detail::ceil_log2(size), numArrays);
+		}
+
+		/**
+		 * @brief Preallocate memory and fault in its pages with `threads`
+		 * threads, all hardware threads if 0.
+		 */
+		void reserve(std::size_t numElements, std::size_t threads)
+		{
+			single_storage().reserve(numElements, threads);
+		}
+
+		/**
+		 * @brief Preallocate memory and fault in its pages in a background
+		 * thread, objects may be allocated meanwhile.
+		 * @detail The chunk provider needs `populate()` for this to happen
+		 * in background, e.g. lida::MmapChunkProvider, otherwise pages are
+		 * faulted in before returning. Don't release memory of the pool
+		 * before the future is ready.
+		 */
+		[[nodiscard]]
+		std::future<void> reserve_async(std::size_t numElements)
+		{
+			return single_storage().reserve_async(numElements);
+		}
+
+		/**
+		 * @brief Release memory of free chunks which the storage keeps
+		 * for reuse, see DefaultPoolTraits::retained_chunks.
+		 */
+		void shrink_to_fit() const noexcept
+		{
+			for_each_storage([](auto& storage) { storage.shrink_to_fit(); });
+		}
+
+		/**
+		 * @brief Release cached free chunks of this pool's storages until
+		 * they take no more than `bytes_to_keep` bytes together.
+		 * @return count of released bytes.
+		 */
+		std::size_t trim(std::size_t bytes_to_keep) const noexcept
 		{
-			auto& chunks = get_chunks();
-			constexpr auto max = std::numeric_limits<uint8_t>::max();
-			std::size_t count = (numElements % max == 0) ?
-				numElements / max : numElements / max + 1;
-			if (count > chunks.size())
-				chunks.resize(count);
+			std::size_t released = 0;
+			for_each_storage([&](auto& storage)
+			{
+				released += storage.trim(bytes_to_keep);
+				bytes_to_keep -= std::min(bytes_to_keep, storage.cached_bytes());
+			});
+			return released;
+		}
+
+		/**
+		 * @brief Usage of memory summed over the storage of single objects
+		 * and storages of arrays, an array counts as one object.
+		 */
+		PoolStatistics statistics() const noexcept
+		{
+			PoolStatistics stats;
+			for_each_storage([&](auto& storage) { stats += storage.statistics(); });
+			return stats;
+		}
+
+		/**
+		 * @brief Count of chunks of this pool's storages which hold objects
+		 * and have no more than `max_occupancy` (from 0 to 1) of slots used.
+		 */
+		std::size_t sparse_chunks(double max_occupancy) const noexcept
+		{
+			std::size_t count = 0;
+			for_each_storage([&](auto& storage) { count += storage.sparse_chunks(max_occupancy); });
+			return count;
+		}
+
+		/**
+		 * @brief Call `f(T&)` for each object returned by `allocate(1)` and
+		 * not deallocated yet.
+		 * @detail Visits chunks one after another and objects of a chunk in
+		 * address order, which is much faster than following pointers of a
+		 * container. All visited objects must be constructed. Arrays aren't
+		 * visited. Storage of the pool mustn't have other types in it, so
+		 * `Traits::share_storage` must be false.
+		 */
+		template<typename F>
+		void for_each_live(F&& f)
+		{
+			static_assert(!Traits::share_storage, "MemoryPool:: for_each_live() can't be used with shared storage");
+			single_storage().for_each_allocated([&](void* ptr) { f(*reinterpret_cast<T*>(ptr)); });
 		}
 
-		template<typename U, std::size_t H>
-		constexpr bool operator==(const MemoryPool<U, H>&)
+		/**
+		 * @brief Spans of chunks which hold objects returned by `allocate(1)`.
+		 * @detail Each span can be processed by its own worker:
+		 * @code
+		 * auto spans = pool.chunk_spans();
+		 * std::for_each(std::execution::par, spans.begin(), spans.end(), [](auto span)
+		 * {
+		 *     span.for_each_live([](Particle& p) { p.move(); });
+		 * });
+		 * @endcode
+		 * Same restrictions as for for_each_live() apply.
+		 */
+		[[nodiscard]]
+		std::vector<chunk_span> chunk_spans()
+		{
+			static_assert(!Traits::share_storage, "MemoryPool:: chunk_spans() can't be used with shared storage");
+			std::vector<chunk_span> spans;
+			single_storage().for_each_chunk([&](const auto& chunk) { spans.emplace_back(chunk); });
+			return spans;
+		}
+
+		/**
+		 * @brief Whether an object returned by `allocate(1)` lies in a chunk
+		 * which is being evacuated, see lida::Compaction.
+		 */
+		static bool is_evacuating(const T* ptr) noexcept
+		{
+			return storage_type<0>::is_evacuating(ptr);
+		}
+
+		/// Resource of the pool, nullptr if it uses global storages.
+		MemoryPoolResource* pool_resource() const noexcept
+		{
+			return resource;
+		}
+
+		/**
+		 * @brief Allocators are equal when they have the same group and
+		 * traits and use the same resource or both use shared storage.
+		 */
+		template<typename U, std::size_t H, typename UTraits>
+		constexpr bool operator==(const MemoryPool<U, H, UTraits>& rhs) const noexcept
 			{
-				return true;
+				return G == H && std::is_same_v<Traits, UTraits> && resource == rhs.resource;
 			}
-		template<typename U, std::size_t H>
-		constexpr bool operator!=(const MemoryPool<U, H>& rhs)
+		template<typename U, std::size_t H, typename UTraits>
+		constexpr bool operator!=(const MemoryPool<U, H, UTraits>& rhs) const noexcept
 			{
 				return !(*this == rhs);
 			}
@@ -0,0 +1,233 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "MemoryPool.hpp"
+
+namespace lida
+{
+	namespace detail
+	{
+		/**
+		 * @brief List of memory blocks from which objects are allocated by
+		 * bumping a pointer. Objects are never deallocated one by one.
+		 * @detail Blocks are `Traits::chunk_size` bytes or bigger if an
+		 * allocation doesn't fit in that, their memory comes from
+		 * `Traits::chunk_provider`. reset() keeps the blocks for reuse.
+		 */
+		template<typename Traits>
+		class MonotonicArena
+		{
+		private:
+			struct Block
+			{
+				Block* next;
+				std::size_t size;
+			};
+
+			static constexpr std::size_t block_align = alignof(std::max_align_t);
+			static constexpr std::size_t header_size =
+				(sizeof(Block) + block_align - 1) / block_align * block_align;
+
+			typename Traits::chunk_provider provider;
+			Block* head = nullptr;
+			Block* current = nullptr;
+			std::uintptr_t cursor = 0;
+			std::uintptr_t end = 0;
+
+		public:
+			MonotonicArena() = default;
+			~MonotonicArena() noexcept
+			{
+				release();
+			}
+			MonotonicArena(const MonotonicArena&) = delete;
+			MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+			[[nodiscard]]
+			void* allocate(std::size_t size, std::size_t align)
+			{
+				auto ptr = (cursor + align - 1) & ~(align - 1);
+				if (ptr + size > end || !current)
+				{
+					next_block(size + align);
+					ptr = (cursor + align - 1) & ~(align - 1);
+				}
+				cursor = ptr + size;
+				return reinterpret_cast<void*>(ptr);
+			}
+
+			/**
+			 * @brief Make sure that `size` bytes can be allocated without
+			 * requesting memory.
+			 */
+			void reserve(std::size_t size)
+			{
+				if (!current || end - cursor < size)
+					next_block(size);
+			}
+
+			/**
+			 * @brief Invalidate all objects, keep blocks for next allocations.
+			 */
+			void reset() noexcept
+			{
+				current = head;
+				if (current)
+					set_cursor(current);
+			}
+
+			/**
+			 * @brief Invalidate all objects and release blocks.
+			 */
+			void release() noexcept
+			{
+				while (head)
+				{
+					auto next = head->next;
+					provider.deallocate(head, head->size, block_align);
+					head = next;
+				}
+				current = nullptr;
+				cursor = end = 0;
+			}
+
+		private:
+			void set_cursor(Block* block) noexcept
+			{
+				cursor = reinterpret_cast<std::uintptr_t>(block) + header_size;
+				end = reinterpret_cast<std::uintptr_t>(block) + block->size;
+			}
+
+			// move to a block with at least `size` free bytes
+			void next_block(std::size_t size)
+			{
+				// blocks kept by reset() are reused while they are big enough
+				auto next = current ? current->next : head;
+				if (!next || next->size - header_size < size)
+				{
+					auto bytes = header_size + size;
+					if (bytes < Traits::chunk_size)
+						bytes = Traits::chunk_size;
+					auto block = static_cast<Block*>(provider.allocate(bytes, block_align));
+					block->size = bytes;
+					block->next = next;
+					if (current)
+						current->next = block;
+					else
+						head = block;
+					next = block;
+				}
+				current = next;
+				set_cursor(current);
+			}
+		};
+	}
+
+	/**
+	 * @brief STL compatible allocator which allocates objects by bumping
+	 * a pointer in big blocks and never deallocates them one by one.
+	 * @detail Use it for containers which are torn down together: after
+	 * they are destroyed reset() or release() frees all their memory at
+	 * once. Allocators of all types in a group share one arena.
+	 * The allocator is not thread safe.
+	 * @tparam T allocating type.
+	 * @tparam G allocator's group, see lida::MemoryPool.
+	 * @tparam Traits tunables of the arena, `chunk_size` is size of blocks.
+	 */
+	template<typename T, std::size_t G = 0, typename Traits = DefaultPoolTraits>
+	class MonotonicPool
+	{
+	private:
+		static auto& get_arena()
+		{
+			return detail::static_storage<detail::MonotonicArena<Traits>, void, G>();
+		}
+
+	public:
+		static constexpr std::size_t group = G;
+		using value_type = T;
+		template<typename U>
+		struct rebind
+		{
+			using other = MonotonicPool<U, G, Traits>;
+		};
+
+		MonotonicPool() = default;
+		template<typename U>
+		MonotonicPool(const MonotonicPool<U, G, Traits>&) noexcept {}
+
+		/**
+		 * @brief Allocate an object or an array of objects from group's arena.
+		 * @param size count of objects.
+		 */
+		[[nodiscard]]
+		static T* allocate(std::size_t size)
+		{
+			// leave room for aligning the block, so arena's sums don't wrap
+			if (size > (std::numeric_limits<std::size_t>::max() / 2) / sizeof(T))
+				throw std::bad_alloc();
+			return static_cast<T*>(get_arena().allocate(sizeof(T) * size, alignof(T)));
+		}
+
+		/**
+		 * @brief Does nothing, memory is freed by reset() or release().
+		 */
+		static void deallocate(T*, std::size_t) noexcept {}
+
+		/**
+		 * @brief Preallocate memory.
+		 * @param numElements minimal count of objects to preallocate.
+		 */
+		static void reserve(std::size_t numElements)
+		{
+			get_arena().reserve(sizeof(T) * numElements);
+		}
+
+		/**
+		 * @brief Free all objects of the group but keep memory for reuse.
+		 * @detail Objects must not be used or deallocated after this.
+		 */
+		static void reset() noexcept
+		{
+			get_arena().reset();
+		}
+
+		/**
+		 * @brief Free all objects and memory of the group.
+		 * @detail Objects must not be used or deallocated after this.
+		 */
+		static void release() noexcept
+		{
+			get_arena().release();
+		}
+
+		/**
+		 * @brief Pools are equal when they have the same group and traits,
+		 * then they share storages.
+		 */
+		template<typename U, std::size_t H, typename UTraits>
+		constexpr bool operator==(const MonotonicPool<U, H, UTraits>&) const noexcept
+			{
+				return G == H && std::is_same_v<Traits, UTraits>;
+			}
+		template<typename U, std::size_t H, typename UTraits>
+		constexpr bool operator!=(const MonotonicPool<U, H, UTraits>& rhs) const noexcept
+			{
+				return !(*this == rhs);
+			}
+	};
+}
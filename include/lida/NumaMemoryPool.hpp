@@ -0,0 +1,224 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+
+#include "ChunkProviders.hpp"
+#include "ConcurrentMemoryPool.hpp"
+
+namespace lida
+{
+	/**
+	 * @brief NUMA node of the CPU the calling thread runs on, 0 if
+	 * it can't be determined.
+	 */
+	inline int current_numa_node() noexcept
+	{
+#if defined(__linux__) && defined(SYS_getcpu)
+		unsigned cpu = 0, node = 0;
+		if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+			return static_cast<int>(node);
+#endif
+		return 0;
+	}
+
+	/**
+	 * @brief Default tunables of lida::NumaMemoryPool, chunks are mapped
+	 * by lida::NumaChunkProvider.
+	 */
+	struct NumaPoolTraits : DefaultPoolTraits
+	{
+		using chunk_provider = NumaChunkProvider<>;
+	};
+
+	namespace detail
+	{
+		/**
+		 * @brief CentralStorage for each NUMA node, created on first use
+		 * with chunk provider bound to the node.
+		 */
+		template<std::size_t ObjSize, std::size_t Align, typename Traits>
+		class NumaCentrals
+		{
+		public:
+			using Central = CentralStorage<ObjSize, Align, Traits>;
+			static constexpr int max_nodes = 64;
+
+		private:
+			std::atomic<Central*> centrals[max_nodes] = {};
+
+		public:
+			NumaCentrals() = default;
+			~NumaCentrals() noexcept
+			{
+				for (auto& central : centrals)
+					delete central.load(std::memory_order_relaxed);
+			}
+			NumaCentrals(const NumaCentrals&) = delete;
+			NumaCentrals& operator=(const NumaCentrals&) = delete;
+
+			/// Give back memory of free chunks of all nodes.
+			std::size_t release_free_memory() noexcept
+			{
+				std::size_t released = 0;
+				for (auto& central : centrals)
+					if (auto ptr = central.load(std::memory_order_acquire))
+						released += ptr->release_free_memory();
+				return released;
+			}
+
+			Central& node(int node)
+			{
+				auto& slot = centrals[node];
+				auto central = slot.load(std::memory_order_acquire);
+				if (central)
+					return *central;
+				auto created = new Central(typename Traits::chunk_provider(node));
+				if (slot.compare_exchange_strong(central, created, std::memory_order_acq_rel))
+					return *created;
+				// other thread was first
+				delete created;
+				return *central;
+			}
+		};
+	}
+
+	/**
+	 * @brief Version of lida::ConcurrentMemoryPool which keeps objects on
+	 * the NUMA node of the thread that allocates them.
+	 * @detail Every NUMA node has its own shared storage whose chunks are
+	 * bound to the node. A thread's cache is attached to the node the
+	 * thread runs on when it first uses the pool, so pin threads to nodes
+	 * for best results. An object freed by a thread of another node goes
+	 * straight back to the stack of remote frees of its own node.
+	 * @tparam T allocating type.
+	 * @tparam G allocator's group, see lida::MemoryPool.
+	 * @tparam Traits tunables of the storage, `chunk_provider` must be
+	 * constructible from a NUMA node index like lida::NumaChunkProvider.
+	 */
+	template<typename T, std::size_t G = 0, typename Traits = NumaPoolTraits>
+	class NumaMemoryPool
+	{
+	private:
+		static constexpr std::size_t size = detail::cached_size<T, Traits>();
+		static constexpr std::size_t align = detail::cached_align<T, Traits>();
+
+		using Centrals = detail::NumaCentrals<size, align, Traits>;
+		using Storage = typename Centrals::Central::Storage;
+
+		struct NodeCache
+		{
+			int node;
+			detail::ThreadCache<size, align, Traits> cache;
+
+			explicit NodeCache(int node)
+				: node(node), cache(get_centrals().node(node)) {}
+		};
+
+		static auto& get_centrals()
+		{
+			return detail::static_storage<Centrals, detail::storage_key_t<T, Traits>, G>();
+		}
+
+		static int local_node() noexcept
+		{
+			return current_numa_node() % Centrals::max_nodes;
+		}
+
+		static auto& get_cache()
+		{
+			thread_local NodeCache cache(local_node());
+			return cache;
+		}
+
+	public:
+		static constexpr std::size_t group = G;
+		using value_type = T;
+		template<typename U>
+		struct rebind
+		{
+			using other = NumaMemoryPool<U, G, Traits>;
+		};
+
+		NumaMemoryPool() = default;
+		template<typename U>
+		NumaMemoryPool(const NumaMemoryPool<U, G, Traits>&) noexcept {}
+
+		/**
+		 * @brief Allocate an object from memory of calling thread's node.
+		 * @param size count of objects, arrays aren't pooled and come from
+		 * aligned `operator new` with the default placement.
+		 */
+		[[nodiscard]]
+		static T* allocate(std::size_t size)
+		{
+			if (size != 1)
+			{
+				if (size > std::numeric_limits<std::size_t>::max() / sizeof(T))
+					throw std::bad_alloc();
+				return static_cast<T*>(::operator new(sizeof(T) * size, std::align_val_t{align}));
+			}
+			return reinterpret_cast<T*>(get_cache().cache.allocate());
+		}
+
+		/**
+		 * @brief Deallocate an object to its node.
+		 * @param size count of objects, same as passed to allocate().
+		 */
+		static void deallocate(T* ptr, std::size_t size)
+		{
+			if (size != 1)
+			{
+				::operator delete(ptr, std::align_val_t{align});
+				return;
+			}
+			auto& local = get_cache();
+			int node = Storage::owner_of(ptr)->chunk_provider().numa_node();
+			if (node == local.node)
+				local.cache.deallocate(ptr);
+			else
+			{
+				auto freed = new(ptr) detail::FreeNode{nullptr};
+				get_centrals().node(node).push_remote(freed, freed);
+			}
+		}
+
+		/**
+		 * @brief Preallocate memory on calling thread's node.
+		 * @param numElements minimal count of objects to preallocate.
+		 */
+		static void reserve(std::size_t numElements)
+		{
+			get_centrals().node(get_cache().node).reserve(numElements);
+		}
+
+		/**
+		 * @brief Pools are equal when they have the same group and traits,
+		 * then they share storages.
+		 */
+		template<typename U, std::size_t H, typename UTraits>
+		constexpr bool operator==(const NumaMemoryPool<U, H, UTraits>&) const noexcept
+			{
+				return G == H && std::is_same_v<Traits, UTraits>;
+			}
+		template<typename U, std::size_t H, typename UTraits>
+		constexpr bool operator!=(const NumaMemoryPool<U, H, UTraits>& rhs) const noexcept
+			{
+				return !(*this == rhs);
+			}
+	};
+}
@@ -0,0 +1,355 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "MemoryPool.hpp"
+
+namespace lida
+{
+	/**
+	 * @brief Reference to an object of lida::ObjectPool which detects use
+	 * after the object was destroyed.
+	 * @detail Holds the index of the object's slot and the generation of
+	 * the slot, which changes when an object is created or destroyed in
+	 * it, so a stale handle resolves to nullptr. The generation has
+	 * `Traits::handle_generation_bits` bits and counts objects created in
+	 * the slot, a stale handle resolves again only after
+	 * `1 << handle_generation_bits` more objects were created in its slot.
+	 * Default constructed handle is null.
+	 */
+	struct ObjectHandle
+	{
+		uint32_t value = 0;
+
+		explicit operator bool() const noexcept
+		{
+			return value != 0;
+		}
+		friend bool operator==(ObjectHandle lhs, ObjectHandle rhs) noexcept
+		{
+			return lhs.value == rhs.value;
+		}
+		friend bool operator!=(ObjectHandle lhs, ObjectHandle rhs) noexcept
+		{
+			return lhs.value != rhs.value;
+		}
+	};
+
+	/**
+	 * @brief Pool of objects which constructs and destroys them itself and
+	 * can refer to them with 32-bit handles.
+	 * @detail Objects live in blocks of `Traits::chunk_size` bytes from
+	 * `Traits::chunk_provider`, objects of a block are stored densely and
+	 * the block's header keeps a generation for each slot. Blocks are
+	 * aligned to their size, so the slot of an object is found by masking
+	 * its address. Blocks are kept until the pool is destroyed or clear()
+	 * is called, which destroys remaining objects. Not thread safe.
+	 * @code
+	 * lida::ObjectPool<Entity> entities;
+	 * auto handle = entities.create_handle(position, velocity);
+	 * if (auto entity = entities.get(handle))
+	 *     entity->update();
+	 * entities.destroy(handle);
+	 * @endcode
+	 * @tparam T type of objects.
+	 * @tparam Traits tunables, see lida::DefaultPoolTraits.
+	 */
+	template<typename T, typename Traits = DefaultPoolTraits>
+	class ObjectPool
+	{
+		static_assert(Traits::handle_generation_bits > 0 && Traits::handle_generation_bits < 32,
+					  "ObjectPool:: handle_generation_bits must be between 1 and 31");
+
+	private:
+		static constexpr std::size_t generation_bits = Traits::handle_generation_bits;
+		static constexpr uint32_t generation_mask = (uint32_t(1) << generation_bits) - 1;
+		static constexpr uint32_t max_slots = uint32_t(1) << (32 - generation_bits);
+		static constexpr uint32_t none = ~uint32_t(0);
+
+		static constexpr std::size_t header_size(std::size_t slots) noexcept
+		{
+			// index of the block, generations and links of slots
+			auto size = sizeof(uint32_t) * (1 + 2 * slots);
+			constexpr auto align = (alignof(T) > alignof(std::max_align_t)) ?
+				alignof(T) : alignof(std::max_align_t);
+			return (size + align - 1) / align * align;
+		}
+
+		static constexpr std::size_t count_slots(std::size_t bytes) noexcept
+		{
+			auto slots = bytes / (sizeof(T) + 2 * sizeof(uint32_t));
+			while (slots > 1 && header_size(slots) + slots * sizeof(T) > bytes)
+				slots--;
+			return slots ? slots : 1;
+		}
+
+		static constexpr std::size_t block_size = (detail::ceil_pow2(Traits::chunk_size) <
+												   header_size(1) + sizeof(T)) ?
+			detail::ceil_pow2(header_size(1) + sizeof(T)) : detail::ceil_pow2(Traits::chunk_size);
+		static constexpr std::size_t block_slots = count_slots(block_size);
+
+		struct Block
+		{
+			uint32_t index;
+			/// Odd if the slot holds an object.
+			uint32_t generations[block_slots];
+			/// Next free slot, `none` ends the list.
+			uint32_t links[block_slots];
+
+			T* data() noexcept
+			{
+				return reinterpret_cast<T*>(reinterpret_cast<uint8_t*>(this) + header_size(block_slots));
+			}
+		};
+
+		typename Traits::chunk_provider provider;
+		std::vector<Block*> blocks;
+		uint32_t free_head = none;
+		std::size_t live = 0;
+
+		Block* block_of(const T* ptr) const noexcept
+		{
+			auto address = reinterpret_cast<std::uintptr_t>(ptr);
+			return reinterpret_cast<Block*>(address & ~(block_size - 1));
+		}
+
+		uint32_t slot_of(const T* ptr) const noexcept
+		{
+			auto block = block_of(ptr);
+			return block->index * block_slots + static_cast<uint32_t>(ptr - block->data());
+		}
+
+		void push_block()
+		{
+			if ((blocks.size() + 1) * block_slots > max_size())
+				throw std::bad_alloc();
+			blocks.reserve(blocks.size() + 1);
+			auto block = static_cast<Block*>(provider.allocate(block_size, block_size));
+			block->index = static_cast<uint32_t>(blocks.size());
+			auto first = block->index * block_slots;
+			for (std::size_t i = 0; i < block_slots; i++)
+			{
+				block->generations[i] = 0;
+				block->links[i] = (i + 1 < block_slots) ? uint32_t(first + i + 1) : free_head;
+			}
+			free_head = first;
+			blocks.push_back(block);
+		}
+
+		Block* block_at(uint32_t slot) const noexcept
+		{
+			return blocks[slot / block_slots];
+		}
+
+		// generations of live objects are odd, so the low bit says nothing
+		static uint32_t handle_generation(uint32_t generation) noexcept
+		{
+			return (generation >> 1) & generation_mask;
+		}
+
+		ObjectHandle make_handle(uint32_t slot) const noexcept
+		{
+			auto generation = block_at(slot)->generations[slot % block_slots];
+			// slot + 1 so that handle with value 0 never resolves
+			return ObjectHandle{ ((slot + 1) << generation_bits) | handle_generation(generation) };
+		}
+
+	public:
+		using value_type = T;
+		using handle_type = ObjectHandle;
+
+		ObjectPool() = default;
+		ObjectPool(const ObjectPool&) = delete;
+		ObjectPool& operator=(const ObjectPool&) = delete;
+		~ObjectPool() noexcept
+		{
+			clear();
+			for (auto block : blocks)
+				provider.deallocate(block, block_size, block_size);
+		}
+
+		/**
+		 * @brief Construct an object in the pool.
+		 * @detail Throws std::bad_alloc if memory or handle indices are
+		 * exhausted, exceptions from T's constructor leave the pool
+		 * unchanged.
+		 */
+		template<typename... Args>
+		[[nodiscard]]
+		T* create(Args&&... args)
+		{
+			if (free_head == none)
+				push_block();
+			auto slot = free_head;
+			auto block = block_at(slot);
+			auto index = slot % block_slots;
+			auto ptr = ::new(static_cast<void*>(block->data() + index)) T(std::forward<Args>(args)...);
+			free_head = block->links[index];
+			block->generations[index]++;
+			live++;
+			return ptr;
+		}
+
+		/**
+		 * @brief Construct an object in the pool and return its handle.
+		 */
+		template<typename... Args>
+		[[nodiscard]]
+		ObjectHandle create_handle(Args&&... args)
+		{
+			return handle_of(create(std::forward<Args>(args)...));
+		}
+
+		/**
+		 * @brief Destroy an object created by this pool.
+		 */
+		void destroy(T* ptr)
+		{
+			auto block = block_of(ptr);
+			auto slot = slot_of(ptr);
+			auto index = slot % block_slots;
+			if constexpr (detail::checks<Traits>)
+			{
+				if (block->index >= blocks.size() || blocks[block->index] != block)
+					detail::pool_error("ObjectPool:: destroying object from other pool");
+				if ((block->generations[index] & 1) == 0)
+					detail::pool_error("ObjectPool:: double destroy");
+			}
+			ptr->~T();
+			block->generations[index]++;
+			block->links[index] = free_head;
+			free_head = slot;
+			live--;
+		}
+
+		/**
+		 * @brief Destroy an object by its handle.
+		 * @return false if the handle is stale.
+		 */
+		bool destroy(ObjectHandle handle)
+		{
+			auto ptr = get(handle);
+			if (ptr)
+				destroy(ptr);
+			return ptr != nullptr;
+		}
+
+		/**
+		 * @brief Get handle to an object created by this pool.
+		 */
+		[[nodiscard]]
+		ObjectHandle handle_of(const T* ptr) const noexcept
+		{
+			return make_handle(slot_of(ptr));
+		}
+
+		/**
+		 * @brief Resolve a handle.
+		 * @return pointer to the object or nullptr if the handle is null or
+		 * the object was destroyed.
+		 */
+		[[nodiscard]]
+		T* get(ObjectHandle handle) const noexcept
+		{
+			auto slot = (handle.value >> generation_bits) - 1;
+			if (handle.value == 0 || slot / block_slots >= blocks.size())
+				return nullptr;
+			auto block = block_at(slot);
+			auto index = slot % block_slots;
+			auto generation = block->generations[index];
+			if ((generation & 1) == 0 || handle_generation(generation) != (handle.value & generation_mask))
+				return nullptr;
+			return block->data() + index;
+		}
+
+		/**
+		 * @brief Call `f(T&)` for each live object.
+		 * @detail Walks blocks in order and objects of a block by address,
+		 * so objects are visited sequentially. `f` mustn't create or destroy
+		 * objects of this pool.
+		 */
+		template<typename F>
+		void for_each(F&& f)
+		{
+			for (auto block : blocks)
+			{
+				auto data = block->data();
+				for (std::size_t i = 0; i < block_slots; i++)
+					if (block->generations[i] & 1)
+						f(data[i]);
+			}
+		}
+
+		/**
+		 * @brief Destroy all objects, blocks are kept for reuse.
+		 * @detail Handles to destroyed objects become stale.
+		 */
+		void clear() noexcept
+		{
+			free_head = none;
+			// rebuild the free list backwards so that low slots are reused first
+			for (std::size_t b = blocks.size(); b-- > 0;)
+			{
+				auto block = blocks[b];
+				auto data = block->data();
+				for (std::size_t i = block_slots; i-- > 0;)
+				{
+					if (block->generations[i] & 1)
+					{
+						data[i].~T();
+						block->generations[i]++;
+					}
+					block->links[i] = free_head;
+					free_head = static_cast<uint32_t>(b * block_slots + i);
+				}
+			}
+			live = 0;
+		}
+
+		/**
+		 * @brief Count of live objects.
+		 */
+		[[nodiscard]]
+		std::size_t size() const noexcept
+		{
+			return live;
+		}
+
+		/**
+		 * @brief Count of objects which fit into allocated blocks.
+		 */
+		[[nodiscard]]
+		std::size_t capacity() const noexcept
+		{
+			return blocks.size() * block_slots;
+		}
+
+		/**
+		 * @brief Max count of objects which the pool can hold.
+		 */
+		[[nodiscard]]
+		static constexpr std::size_t max_size() noexcept
+		{
+			return (max_slots - 1) / block_slots * block_slots;
+		}
+	};
+}
@@ -0,0 +1,193 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+
+namespace lida
+{
+	/**
+	 * @brief Pointer which stores the distance from itself to the object,
+	 * so a structure of such pointers stays valid when its memory is
+	 * mapped at another address.
+	 * @detail Both the pointer and the object must lie in the same mapping,
+	 * see lida::PersistentPool. Copying the pointer recomputes the distance.
+	 * It is a random access iterator and satisfies requirements of
+	 * `std::allocator_traits<A>::pointer`.
+	 */
+	template<typename T>
+	class OffsetPtr
+	{
+		template<typename>
+		friend class OffsetPtr;
+
+	private:
+		// distance from `this` to the object, `null` for nullptr. It can't
+		// point one byte after itself since objects don't overlap
+		static constexpr std::ptrdiff_t null = 1;
+		std::ptrdiff_t offset = null;
+
+		void set(const volatile void* ptr) noexcept
+		{
+			offset = ptr ? reinterpret_cast<std::intptr_t>(ptr) - reinterpret_cast<std::intptr_t>(this) : null;
+		}
+
+	public:
+		using element_type = T;
+		using value_type = std::remove_cv_t<T>;
+		using difference_type = std::ptrdiff_t;
+		using pointer = T*;
+		using reference = std::add_lvalue_reference_t<T>;
+		using iterator_category = std::random_access_iterator_tag;
+
+		OffsetPtr() noexcept = default;
+		OffsetPtr(std::nullptr_t) noexcept {}
+		OffsetPtr(T* ptr) noexcept
+		{
+			set(ptr);
+		}
+		OffsetPtr(const OffsetPtr& rhs) noexcept
+		{
+			set(rhs.get());
+		}
+		template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+		OffsetPtr(const OffsetPtr<U>& rhs) noexcept
+		{
+			set(static_cast<T*>(rhs.get()));
+		}
+		/// Conversions which need `static_cast`, e.g. from `OffsetPtr<void>`.
+		template<typename U, typename = std::enable_if_t<!std::is_convertible_v<U*, T*>>, typename = void>
+		explicit OffsetPtr(const OffsetPtr<U>& rhs) noexcept
+		{
+			set(static_cast<T*>(rhs.get()));
+		}
+		OffsetPtr& operator=(const OffsetPtr& rhs) noexcept
+		{
+			set(rhs.get());
+			return *this;
+		}
+
+		T* get() const noexcept
+		{
+			if (offset == null)
+				return nullptr;
+			return reinterpret_cast<T*>(reinterpret_cast<std::intptr_t>(this) + offset);
+		}
+
+		template<typename U = T>
+		std::enable_if_t<!std::is_void_v<U>, U&> operator*() const noexcept
+		{
+			return *get();
+		}
+		T* operator->() const noexcept
+		{
+			return get();
+		}
+		template<typename U = T>
+		std::enable_if_t<!std::is_void_v<U>, U&> operator[](difference_type i) const noexcept
+		{
+			return get()[i];
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return offset != null;
+		}
+
+		/// For std::pointer_traits.
+		template<typename U = T>
+		static OffsetPtr pointer_to(std::enable_if_t<!std::is_void_v<U>, U&> object) noexcept
+		{
+			return OffsetPtr(std::addressof(object));
+		}
+
+		OffsetPtr& operator+=(difference_type n) noexcept
+		{
+			offset += n * static_cast<difference_type>(sizeof(T));
+			return *this;
+		}
+		OffsetPtr& operator-=(difference_type n) noexcept
+		{
+			offset -= n * static_cast<difference_type>(sizeof(T));
+			return *this;
+		}
+		OffsetPtr& operator++() noexcept
+		{
+			return *this += 1;
+		}
+		OffsetPtr& operator--() noexcept
+		{
+			return *this -= 1;
+		}
+		OffsetPtr operator++(int) noexcept
+		{
+			OffsetPtr old(*this);
+			++*this;
+			return old;
+		}
+		OffsetPtr operator--(int) noexcept
+		{
+			OffsetPtr old(*this);
+			--*this;
+			return old;
+		}
+		friend OffsetPtr operator+(const OffsetPtr& ptr, difference_type n) noexcept
+		{
+			return OffsetPtr(ptr.get() + n);
+		}
+		friend OffsetPtr operator+(difference_type n, const OffsetPtr& ptr) noexcept
+		{
+			return OffsetPtr(ptr.get() + n);
+		}
+		friend OffsetPtr operator-(const OffsetPtr& ptr, difference_type n) noexcept
+		{
+			return OffsetPtr(ptr.get() - n);
+		}
+		friend difference_type operator-(const OffsetPtr& lhs, const OffsetPtr& rhs) noexcept
+		{
+			return lhs.get() - rhs.get();
+		}
+
+		friend bool operator==(const OffsetPtr& lhs, const OffsetPtr& rhs) noexcept
+		{
+			return lhs.get() == rhs.get();
+		}
+		friend bool operator!=(const OffsetPtr& lhs, const OffsetPtr& rhs) noexcept
+		{
+			return lhs.get() != rhs.get();
+		}
+		friend bool operator<(const OffsetPtr& lhs, const OffsetPtr& rhs) noexcept
+		{
+			return lhs.get() < rhs.get();
+		}
+		friend bool operator>(const OffsetPtr& lhs, const OffsetPtr& rhs) noexcept
+		{
+			return lhs.get() > rhs.get();
+		}
+		friend bool operator<=(const OffsetPtr& lhs, const OffsetPtr& rhs) noexcept
+		{
+			return lhs.get() <= rhs.get();
+		}
+		friend bool operator>=(const OffsetPtr& lhs, const OffsetPtr& rhs) noexcept
+		{
+			return lhs.get() >= rhs.get();
+		}
+	};
+}
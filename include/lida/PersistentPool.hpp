@@ -0,0 +1,362 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "OffsetPtr.hpp"
+#include "SmallObjectPool.hpp"
+
+namespace lida
+{
+	namespace detail
+	{
+		/// Size classes of lida::PersistentPool, small classes and powers of two after them.
+		inline constexpr std::size_t persistent_class_count = small_class_count + 48;
+
+		constexpr std::size_t persistent_class_size(std::size_t k) noexcept
+		{
+			return (k < small_class_count) ?
+				small_classes[k] : max_small_size << (k - small_class_count + 1);
+		}
+
+		constexpr std::size_t persistent_class_align(std::size_t k) noexcept
+		{
+			return (k < small_class_count) ? small_class_align(k) : cache_line_size;
+		}
+
+		/// Smallest class which fits `size` bytes aligned by `align`, persistent_class_count if there's none.
+		constexpr std::size_t persistent_class_of(std::size_t size, std::size_t align) noexcept
+		{
+			auto k = small_class_of(size, align);
+			if (k < small_class_count)
+				return k;
+			if (align > cache_line_size)
+				return persistent_class_count;
+			while (k < persistent_class_count && persistent_class_size(k) < size)
+				k++;
+			return k;
+		}
+
+		/**
+		 * @brief Beginning of a lida::PersistentPool's file, all its state
+		 * is here and refers to memory by offsets from the header.
+		 * @detail Memory is bumped from `top` and freed blocks go to the
+		 * free list of their class, a free block keeps the offset of the next
+		 * one in its first bytes.
+		 */
+		struct PersistentHeader
+		{
+			static constexpr uint64_t signature = 0x6c6f6f706164696c; // "lidapool"
+			static constexpr uint64_t format = 1;
+
+			uint64_t magic;
+			uint64_t version;
+			uint64_t size;
+			uint64_t top;
+			uint64_t root;
+			uint64_t root_size;
+			uint64_t free[persistent_class_count];
+
+			uint8_t* base() noexcept
+			{
+				return reinterpret_cast<uint8_t*>(this);
+			}
+
+			void init(std::size_t bytes) noexcept
+			{
+				magic = signature;
+				version = format;
+				size = bytes;
+				top = sizeof(PersistentHeader);
+				root = 0;
+				root_size = 0;
+				for (auto& head : free)
+					head = 0;
+			}
+
+			bool valid(std::size_t bytes) const noexcept
+			{
+				return magic == signature && version == format && size == bytes &&
+					top >= sizeof(PersistentHeader) && top <= size;
+			}
+
+			[[nodiscard]]
+			void* allocate(std::size_t bytes, std::size_t align)
+			{
+				auto k = persistent_class_of(bytes, align);
+				if (k == persistent_class_count)
+					throw std::bad_alloc();
+				if (auto offset = free[k])
+				{
+					std::memcpy(&free[k], base() + offset, sizeof(uint64_t));
+					return base() + offset;
+				}
+				auto class_align = persistent_class_align(k);
+				auto offset = (top + class_align - 1) / class_align * class_align;
+				if (offset > size || size - offset < persistent_class_size(k))
+					throw std::bad_alloc();
+				top = offset + persistent_class_size(k);
+				return base() + offset;
+			}
+
+			void deallocate(void* ptr, std::size_t bytes, std::size_t align) noexcept
+			{
+				auto k = persistent_class_of(bytes, align);
+				uint64_t offset = static_cast<uint8_t*>(ptr) - base();
+				std::memcpy(ptr, &free[k], sizeof(uint64_t));
+				free[k] = offset;
+			}
+		};
+	}
+
+	/**
+	 * @brief STL compatible allocator of objects in a lida::PersistentPool
+	 * whose `pointer` is lida::OffsetPtr.
+	 * @detail The allocator refers to the pool's memory by lida::OffsetPtr
+	 * too, so containers stored in the pool stay valid when the file is
+	 * mapped at another address. Containers persist only if they keep
+	 * all their links as `allocator_traits::pointer`, see README.
+	 */
+	template<typename T>
+	class PersistentAllocator
+	{
+		template<typename>
+		friend class PersistentAllocator;
+
+	private:
+		OffsetPtr<detail::PersistentHeader> header;
+
+	public:
+		using value_type = T;
+		using pointer = OffsetPtr<T>;
+		using const_pointer = OffsetPtr<const T>;
+		using void_pointer = OffsetPtr<void>;
+		using const_void_pointer = OffsetPtr<const void>;
+		using propagate_on_container_copy_assignment = std::true_type;
+		using propagate_on_container_move_assignment = std::true_type;
+		using propagate_on_container_swap = std::true_type;
+		template<typename U>
+		struct rebind
+		{
+			using other = PersistentAllocator<U>;
+		};
+
+		explicit PersistentAllocator(detail::PersistentHeader* header) noexcept
+			: header(header) {}
+		PersistentAllocator(const PersistentAllocator& rhs) noexcept = default;
+		template<typename U>
+		PersistentAllocator(const PersistentAllocator<U>& rhs) noexcept
+			: header(rhs.header) {}
+		PersistentAllocator& operator=(const PersistentAllocator&) noexcept = default;
+
+		[[nodiscard]]
+		pointer allocate(std::size_t size)
+		{
+			if (size > std::numeric_limits<std::size_t>::max() / sizeof(T))
+				throw std::bad_alloc();
+			return pointer(static_cast<T*>(header->allocate(sizeof(T) * size, alignof(T))));
+		}
+
+		void deallocate(pointer ptr, std::size_t size) noexcept
+		{
+			header->deallocate(ptr.get(), sizeof(T) * size, alignof(T));
+		}
+
+		template<typename U>
+		bool operator==(const PersistentAllocator<U>& rhs) const noexcept
+		{
+			return header == rhs.header;
+		}
+		template<typename U>
+		bool operator!=(const PersistentAllocator<U>& rhs) const noexcept
+		{
+			return !(*this == rhs);
+		}
+	};
+
+	/**
+	 * @brief Memory of a file mapped with `mmap(MAP_SHARED)`, objects
+	 * allocated in it stay in the file and are found again when the file
+	 * is mapped next time.
+	 * @detail Objects must refer to each other with lida::OffsetPtr since
+	 * the file may be mapped at another address, containers get such
+	 * pointers from lida::PersistentAllocator. The pool doesn't grow, its
+	 * size is set when the file is created. It has a root object which is
+	 * the entry point to the rest of the data, usually a container:
+	 * @code
+	 * using Table = std::vector<Record, lida::PersistentAllocator<Record>>;
+	 * lida::PersistentPool pool("reference.data", std::size_t(1) << 30);
+	 * auto& table = pool.root<Table>(pool.allocator<Record>());
+	 * if (pool.created())
+	 *     load(table);
+	 * @endcode
+	 * Size classes are same as lida::SmallObjectPool's up to 512 bytes
+	 * and powers of two after that. Not thread safe, and the file must not
+	 * be mapped by two pools at once.
+	 */
+	class PersistentPool
+	{
+	private:
+		detail::PersistentHeader* header = nullptr;
+		std::size_t bytes = 0;
+		bool fresh = false;
+
+		[[noreturn]]
+		static void fail(int fd, const char* what)
+		{
+			auto error = errno;
+			if (fd >= 0)
+				::close(fd);
+			throw std::system_error(error, std::generic_category(), what);
+		}
+
+	public:
+		/**
+		 * @brief Map the file at `path`, create it with `size` bytes if it
+		 * doesn't exist.
+		 * @detail If the file exists it's mapped with its own size and
+		 * `size` is ignored. Throws std::system_error if the file can't be
+		 * opened or mapped, std::runtime_error if it isn't a pool.
+		 */
+		PersistentPool(const char* path, std::size_t size)
+		{
+			int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+			if (fd < 0)
+				fail(fd, "PersistentPool:: can't open file");
+			struct stat info;
+			if (::fstat(fd, &info) != 0)
+				fail(fd, "PersistentPool:: can't stat file");
+			fresh = info.st_size == 0;
+			if (fresh)
+			{
+				if (size < sizeof(detail::PersistentHeader))
+					size = sizeof(detail::PersistentHeader);
+				if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+					fail(fd, "PersistentPool:: can't resize file");
+				bytes = size;
+			}
+			else
+				bytes = static_cast<std::size_t>(info.st_size);
+			auto ptr = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (ptr == MAP_FAILED)
+				fail(fd, "PersistentPool:: can't map file");
+			::close(fd);
+			header = static_cast<detail::PersistentHeader*>(ptr);
+			if (fresh)
+				header->init(bytes);
+			else if (bytes < sizeof(detail::PersistentHeader) || !header->valid(bytes))
+			{
+				::munmap(ptr, bytes);
+				detail::pool_error("PersistentPool:: file is not a pool");
+			}
+		}
+		~PersistentPool() noexcept
+		{
+			::munmap(header, bytes);
+		}
+		PersistentPool(const PersistentPool&) = delete;
+		PersistentPool& operator=(const PersistentPool&) = delete;
+
+		/// Whether the file was created by this pool.
+		bool created() const noexcept
+		{
+			return fresh;
+		}
+
+		[[nodiscard]]
+		void* allocate(std::size_t size, std::size_t align)
+		{
+			return header->allocate(size, align);
+		}
+
+		void deallocate(void* ptr, std::size_t size, std::size_t align) noexcept
+		{
+			header->deallocate(ptr, size, align);
+		}
+
+		/**
+		 * @brief Get the root object, construct it from `args` if the pool
+		 * has none.
+		 * @detail Throws std::runtime_error if the root has other size than
+		 * `T`.
+		 */
+		template<typename T, typename... Args>
+		T& root(Args&&... args)
+		{
+			if (header->root)
+			{
+				if (header->root_size != sizeof(T))
+					detail::pool_error("PersistentPool:: root has other type");
+				return *reinterpret_cast<T*>(header->base() + header->root);
+			}
+			auto ptr = allocate(sizeof(T), alignof(T));
+			T* object;
+			try
+			{
+				object = ::new(ptr) T(std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				deallocate(ptr, sizeof(T), alignof(T));
+				throw;
+			}
+			header->root = reinterpret_cast<uint8_t*>(object) - header->base();
+			header->root_size = sizeof(T);
+			return *object;
+		}
+
+		/// Allocator of objects in this pool.
+		template<typename T>
+		PersistentAllocator<T> allocator() noexcept
+		{
+			return PersistentAllocator<T>(header);
+		}
+
+		/**
+		 * @brief Write changes to the file with `msync`.
+		 */
+		void flush() noexcept
+		{
+			::msync(header, bytes, MS_SYNC);
+		}
+
+		/// Size of the file.
+		std::size_t size() const noexcept
+		{
+			return bytes;
+		}
+
+		/// Bytes taken from the file so far, including freed ones.
+		std::size_t used() const noexcept
+		{
+			return header->top;
+		}
+	};
+
+}
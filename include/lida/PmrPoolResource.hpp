@@ -0,0 +1,146 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory_resource>
+#include <tuple>
+#include <utility>
+
+#include "MemoryPool.hpp"
+
+namespace lida
+{
+	/**
+	 * @brief `std::pmr::memory_resource` which serves allocations from
+	 * chunks of lida::MemoryPool.
+	 * @detail Requests are rounded up to power of two size classes from
+	 * 8 bytes up to `Traits::max_array_bytes`, each class has own chunks.
+	 * Bigger or over-aligned (more than lida::cache_line_size) requests go
+	 * to the upstream resource. The resource is not thread safe, like
+	 * `std::pmr::unsynchronized_pool_resource`, and releases all its memory
+	 * when destroyed.
+	 * @code
+	 * lida::PmrPoolResource<> resource;
+	 * std::pmr::map<int, std::pmr::string> m(&resource);
+	 * @endcode
+	 * @tparam Traits tunables of the storages, see lida::DefaultPoolTraits.
+	 */
+	template<typename Traits = DefaultPoolTraits>
+	class PmrPoolResource : public std::pmr::memory_resource
+	{
+	private:
+		static constexpr std::size_t min_block = 8;
+		static constexpr std::size_t max_align = cache_line_size;
+
+	public:
+		/// Biggest request which is served from chunks.
+		static constexpr std::size_t max_block =
+			(Traits::max_array_bytes < min_block) ? min_block :
+			std::size_t(1) << detail::floor_log2(Traits::max_array_bytes);
+
+	private:
+		static constexpr std::size_t classes =
+			detail::floor_log2(max_block / min_block) + 1;
+
+		/// Storage of K-th size class, `min_block << K` bytes.
+		template<std::size_t K>
+		using storage_type = detail::PoolStorage<(min_block << K),
+												 ((min_block << K) < max_align) ? (min_block << K) : max_align,
+												 Traits>;
+
+		template<std::size_t... K>
+		static auto make_storages(std::index_sequence<K...>) -> std::tuple<storage_type<K>...>;
+
+		decltype(make_storages(std::make_index_sequence<classes>())) storages;
+		std::pmr::memory_resource* upstream;
+
+		template<std::size_t K = 0>
+		void* allocate_from(std::size_t k)
+		{
+			if constexpr (K + 1 == classes)
+				return std::get<K>(storages).allocate();
+			else if (k == K)
+				return std::get<K>(storages).allocate();
+			else
+				return allocate_from<K + 1>(k);
+		}
+
+		template<std::size_t K = 0>
+		void deallocate_to(void* ptr, std::size_t k)
+		{
+			if constexpr (K + 1 == classes)
+				std::get<K>(storages).deallocate(ptr);
+			else if (k == K)
+				std::get<K>(storages).deallocate(ptr);
+			else
+				deallocate_to<K + 1>(ptr, k);
+		}
+
+		static std::size_t size_class(std::size_t bytes, std::size_t alignment) noexcept
+		{
+			auto size = (bytes > alignment) ? bytes : alignment;
+			return (size <= min_block) ? 0 : detail::ceil_log2(size) - detail::floor_log2(min_block);
+		}
+
+	public:
+		explicit PmrPoolResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) noexcept
+			: upstream(upstream) {}
+		PmrPoolResource(const PmrPoolResource&) = delete;
+		PmrPoolResource& operator=(const PmrPoolResource&) = delete;
+
+		/**
+		 * @brief Release memory of all blocks allocated from size classes.
+		 */
+		void release() noexcept
+		{
+			std::apply([](auto&... storage) { (storage.release(), ...); }, storages);
+		}
+
+		/**
+		 * @brief Release free chunks cached by size classes.
+		 */
+		void shrink_to_fit() noexcept
+		{
+			std::apply([](auto&... storage) { (storage.shrink_to_fit(), ...); }, storages);
+		}
+
+		std::pmr::memory_resource* upstream_resource() const noexcept
+		{
+			return upstream;
+		}
+
+	protected:
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override
+		{
+			if (bytes > max_block || alignment > max_align)
+				return upstream->allocate(bytes, alignment);
+			return allocate_from(size_class(bytes, alignment));
+		}
+
+		void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override
+		{
+			if (bytes > max_block || alignment > max_align)
+				upstream->deallocate(ptr, bytes, alignment);
+			else
+				deallocate_to(ptr, size_class(bytes, alignment));
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+	};
+}
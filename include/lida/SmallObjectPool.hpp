@@ -0,0 +1,233 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <utility>
+
+#include "MemoryPool.hpp"
+
+namespace lida
+{
+	namespace detail
+	{
+		/// Slot sizes of lida::SmallObjectPool's size classes.
+		inline constexpr std::size_t small_classes[] = {
+			8, 16, 32, 48, 64, 96, 128, 192, 256, 384, 512,
+		};
+		inline constexpr std::size_t small_class_count =
+			sizeof(small_classes) / sizeof(small_classes[0]);
+		/// Biggest object served by lida::SmallObjectPool.
+		inline constexpr std::size_t max_small_size = small_classes[small_class_count - 1];
+
+		/// Alignment of slots of K-th class, the largest power of two
+		/// dividing its size but no more than a cache line.
+		constexpr std::size_t small_class_align(std::size_t k) noexcept
+		{
+			auto size = small_classes[k];
+			auto align = size & (~size + 1);
+			return (align < cache_line_size) ? align : cache_line_size;
+		}
+
+		/**
+		 * @brief Smallest class which fits `size` bytes aligned by
+		 * `align`, small_class_count if there's none.
+		 */
+		constexpr std::size_t small_class_of(std::size_t size, std::size_t align) noexcept
+		{
+			std::size_t k = 0;
+			while (k < small_class_count &&
+				   (small_classes[k] < size || small_class_align(k) < align))
+				k++;
+			return k;
+		}
+
+		/// Class of sizes rounded up to 8 bytes, for lookups at runtime.
+		struct SmallClassTable
+		{
+			unsigned char classes[max_small_size / 8 + 1] = {};
+
+			constexpr SmallClassTable() noexcept
+			{
+				for (std::size_t i = 0; i <= max_small_size / 8; i++)
+					classes[i] = static_cast<unsigned char>(small_class_of(i * 8, 1));
+			}
+		};
+
+		inline constexpr SmallClassTable small_class_table{};
+	}
+
+	/**
+	 * @brief Allocator which serves all types from a fixed table of size
+	 * classes from 8 to 512 bytes, so types of similar size share chunks.
+	 * @detail A program with many node types gets a few storages instead of
+	 * one per type, which means less partially filled chunks. The class of
+	 * single objects is chosen at compile time, arrays up to 512 bytes are
+	 * looked up in a table. Bigger or over-aligned (more than
+	 * lida::cache_line_size) allocations use global `operator new`. Like
+	 * lida::MemoryPool it is not thread safe.
+	 * @code
+	 * std::map<int, Order, std::less<int>, lida::SmallObjectPool<std::pair<const int, Order>>> m;
+	 * @endcode
+	 * @tparam T allocating type.
+	 * @tparam G allocator's group, see lida::MemoryPool.
+	 * @tparam Traits tunables of the storages, see lida::DefaultPoolTraits.
+	 */
+	template<typename T, std::size_t G = 0, typename Traits = DefaultPoolTraits>
+	class SmallObjectPool
+	{
+	private:
+		template<std::size_t K>
+		using storage_type = detail::PoolStorage<detail::small_classes[K],
+												 detail::small_class_align(K), Traits>;
+
+		template<std::size_t K>
+		static auto& get_storage()
+		{
+			return detail::static_storage<storage_type<K>,
+										  detail::SizeClass<detail::small_classes[K],
+															detail::small_class_align(K)>, G>();
+		}
+
+		/// Class of single objects.
+		static constexpr std::size_t object_class = detail::small_class_of(sizeof(T), alignof(T));
+
+		static std::size_t class_of(std::size_t bytes) noexcept
+		{
+			if (bytes > detail::max_small_size)
+				return detail::small_class_count;
+			auto k = std::size_t(detail::small_class_table.classes[(bytes + 7) / 8]);
+			while (k < detail::small_class_count && detail::small_class_align(k) < alignof(T))
+				k++;
+			return k;
+		}
+
+		template<std::size_t K = 0>
+		static void* allocate_from(std::size_t k, std::size_t bytes)
+		{
+			if constexpr (K == detail::small_class_count)
+				return ::operator new(bytes, std::align_val_t{alignof(T)});
+			else if (k == K)
+				return get_storage<K>().allocate();
+			else
+				return allocate_from<K + 1>(k, bytes);
+		}
+
+		template<std::size_t K = 0>
+		static void deallocate_to(void* ptr, std::size_t k)
+		{
+			if constexpr (K == detail::small_class_count)
+				::operator delete(ptr, std::align_val_t{alignof(T)});
+			else if (k == K)
+				get_storage<K>().deallocate(ptr);
+			else
+				deallocate_to<K + 1>(ptr, k);
+		}
+
+		template<typename F, std::size_t K = 0>
+		static void for_each_storage(F&& f)
+		{
+			if constexpr (K < detail::small_class_count)
+			{
+				f(get_storage<K>());
+				for_each_storage<F, K + 1>(std::forward<F>(f));
+			}
+		}
+
+	public:
+		static constexpr std::size_t group = G;
+		using value_type = T;
+		template<typename U>
+		struct rebind
+		{
+			using other = SmallObjectPool<U, G, Traits>;
+		};
+
+		SmallObjectPool() noexcept = default;
+		template<typename U>
+		SmallObjectPool(const SmallObjectPool<U, G, Traits>&) noexcept {}
+
+		/**
+		 * @brief Allocate an object or an array of objects.
+		 * @param size count of objects.
+		 */
+		[[nodiscard]]
+		static T* allocate(std::size_t size)
+		{
+			if (size <= 1)
+			{
+				if constexpr (object_class < detail::small_class_count)
+					return reinterpret_cast<T*>(get_storage<object_class>().allocate());
+			}
+			if (size > std::numeric_limits<std::size_t>::max() / sizeof(T))
+				throw std::bad_alloc();
+			return reinterpret_cast<T*>(allocate_from(class_of(size * sizeof(T)), size * sizeof(T)));
+		}
+
+		/**
+		 * @brief Deallocate an object or an array of objects.
+		 * @param size count of objects, same as passed to allocate().
+		 */
+		static void deallocate(T* ptr, std::size_t size)
+		{
+			if (size <= 1)
+			{
+				if constexpr (object_class < detail::small_class_count)
+				{
+					get_storage<object_class>().deallocate(ptr);
+					return;
+				}
+			}
+			deallocate_to(ptr, class_of(size * sizeof(T)));
+		}
+
+		/**
+		 * @brief Release free chunks cached by all size classes of the group.
+		 */
+		static void shrink_to_fit() noexcept
+		{
+			for_each_storage([](auto& storage) { storage.shrink_to_fit(); });
+		}
+
+		/**
+		 * @brief Usage of memory summed over all size classes of the group,
+		 * which are shared by all types.
+		 */
+		static PoolStatistics statistics() noexcept
+		{
+			PoolStatistics stats;
+			for_each_storage([&](auto& storage) { stats += storage.statistics(); });
+			return stats;
+		}
+
+		/**
+		 * @brief Pools are equal when they have the same group and traits,
+		 * then they share storages.
+		 */
+		template<typename U, std::size_t H, typename UTraits>
+		constexpr bool operator==(const SmallObjectPool<U, H, UTraits>&) const noexcept
+			{
+				return G == H && std::is_same_v<Traits, UTraits>;
+			}
+		template<typename U, std::size_t H, typename UTraits>
+		constexpr bool operator!=(const SmallObjectPool<U, H, UTraits>& rhs) const noexcept
+			{
+				return !(*this == rhs);
+			}
+	};
+}
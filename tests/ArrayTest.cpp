@@ -0,0 +1,54 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include <lida/MemoryPool.hpp>
+
+#include "Check.hpp"
+
+/*
+ * Arrays of every size: pooled power-of-two classes, exact sizes above
+ * `max_array_bytes` and counts whose byte size overflows.
+ */
+
+int main()
+{
+	lida::MemoryPool<int> pool;
+
+	for (std::size_t n = 2; n <= 1000; n += 7)
+	{
+		int* array = pool.allocate(n);
+		for (std::size_t i = 0; i < n; i++)
+			array[i] = int(i);
+		LIDA_CHECK(array[n - 1] == int(n - 1));
+		pool.deallocate(array, n);
+	}
+
+	{
+		std::vector<int, lida::MemoryPool<int>> vector;
+		vector.reserve(1000001);
+		for (int i = 0; i < 1000001; i++)
+			vector.push_back(i);
+		LIDA_CHECK(vector.capacity() == 1000001);
+		LIDA_CHECK(vector.back() == 1000000);
+	}
+
+	LIDA_CHECK_THROWS(pool.allocate((std::size_t(1) << 62) + 5), std::bad_alloc);
+	LIDA_CHECK_THROWS(pool.allocate(std::size_t(-1)), std::bad_alloc);
+	LIDA_CHECK(pool.statistics().live_objects == 0);
+}
@@ -0,0 +1,52 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+/*
+ * Checks of the tests, unlike `assert` they work in release builds.
+ */
+
+namespace lida_test
+{
+	[[noreturn]]
+	inline void fail(const char* expression, const char* file, int line)
+	{
+		std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+		std::exit(EXIT_FAILURE);
+	}
+}
+
+#define LIDA_CHECK(expression)											\
+	((expression) ? void(0) : ::lida_test::fail(#expression, __FILE__, __LINE__))
+
+#define LIDA_CHECK_THROWS(expression, exception)						\
+	do																	\
+	{																	\
+		bool thrown = false;											\
+		try																\
+		{																\
+			(void)(expression);											\
+		}																\
+		catch (const exception&)										\
+		{																\
+			thrown = true;												\
+		}																\
+		if (!thrown)													\
+			::lida_test::fail(#expression " throws " #exception, __FILE__, __LINE__); \
+	} while (false)
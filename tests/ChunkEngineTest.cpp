@@ -0,0 +1,123 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <lida/MemoryPool.hpp>
+
+#include "Check.hpp"
+
+/*
+ * Both chunk engines under random allocations and deallocations, bulk
+ * operations and chunk sizes.
+ */
+
+struct SmallChunks : lida::DefaultPoolTraits
+{
+	static constexpr std::size_t chunk_size = 256;
+	static constexpr std::size_t retained_chunks = 0;
+};
+
+struct Bitmap : lida::DefaultPoolTraits
+{
+	static constexpr lida::ChunkEngine chunk_engine = lida::ChunkEngine::bitmap;
+};
+
+struct SmallBitmap : SmallChunks
+{
+	static constexpr lida::ChunkEngine chunk_engine = lida::ChunkEngine::bitmap;
+};
+
+struct BigBitmap : Bitmap
+{
+	static constexpr std::size_t chunk_size = 1 << 20;
+};
+
+template<typename T, typename Traits>
+void random_usage()
+{
+	lida::MemoryPool<T, 0, Traits> pool;
+	std::vector<T*> objects;
+	std::mt19937 rng(1);
+	for (int i = 0; i < 100000; i++)
+	{
+		if (objects.empty() || rng() % 3)
+		{
+			auto ptr = pool.allocate(1);
+			LIDA_CHECK(reinterpret_cast<std::uintptr_t>(ptr) % alignof(T) == 0);
+			*ptr = T(objects.size());
+			objects.push_back(ptr);
+		}
+		else
+		{
+			auto i = rng() % objects.size();
+			std::swap(objects[i], objects.back());
+			pool.deallocate(objects.back(), 1);
+			objects.pop_back();
+		}
+	}
+	LIDA_CHECK(pool.statistics().live_objects == objects.size());
+	std::sort(objects.begin(), objects.end());
+	LIDA_CHECK(std::adjacent_find(objects.begin(), objects.end()) == objects.end());
+
+	std::size_t visited = 0;
+	pool.for_each_live([&](T&) { visited++; });
+	LIDA_CHECK(visited == objects.size());
+
+	for (auto ptr : objects)
+		pool.deallocate(ptr, 1);
+	T* bulk[300];
+	pool.allocate_bulk(bulk, 300);
+	std::sort(bulk, bulk + 300);
+	LIDA_CHECK(std::adjacent_find(bulk, bulk + 300) == bulk + 300);
+	pool.deallocate_bulk(bulk, 300);
+	LIDA_CHECK(pool.statistics().live_objects == 0);
+	pool.shrink_to_fit();
+	LIDA_CHECK(pool.statistics().chunks == 0);
+}
+
+template<typename Traits>
+void container_usage()
+{
+	std::set<int, std::less<int>, lida::MemoryPool<int, 0, Traits>> set;
+	for (int i = 0; i < 10000; i++)
+		set.insert(i);
+	for (int i = 0; i < 10000; i += 2)
+		set.erase(i);
+	LIDA_CHECK(set.size() == 5000 && *set.begin() == 1);
+}
+
+int main()
+{
+	random_usage<char, lida::DefaultPoolTraits>();
+	random_usage<int, lida::DefaultPoolTraits>();
+	random_usage<double, SmallChunks>();
+	random_usage<char, Bitmap>();
+	random_usage<long, Bitmap>();
+	random_usage<char, SmallBitmap>();
+	random_usage<long, BigBitmap>();
+	container_usage<lida::DefaultPoolTraits>();
+	container_usage<Bitmap>();
+
+	// chunks are no bigger than their slot limits need
+	using CharChunk = lida::detail::MemoryChunk<1, 1, lida::DefaultPoolTraits>;
+	static_assert(CharChunk::capacity() == 255 && CharChunk::size() == 512);
+	using LongBitmapChunk = lida::detail::BitmapChunk<8, 8, BigBitmap>;
+	static_assert(LongBitmapChunk::capacity() == 4096 && LongBitmapChunk::size() < BigBitmap::chunk_size);
+}
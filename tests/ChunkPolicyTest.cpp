@@ -0,0 +1,90 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <map>
+#include <random>
+#include <vector>
+
+#include <lida/MemoryPool.hpp>
+
+#include "Check.hpp"
+
+/*
+ * Chunk policies keep all objects valid and ChunkPolicy::fullest leaves
+ * no more partial chunks than ChunkPolicy::lifo.
+ */
+
+struct Lifo : lida::DefaultPoolTraits
+{
+	static constexpr std::size_t chunk_size = 1024;
+	static constexpr std::size_t retained_chunks = 0;
+};
+
+struct Fullest : Lifo
+{
+	static constexpr lida::ChunkPolicy chunk_policy = lida::ChunkPolicy::fullest;
+};
+
+struct FullestBitmap : Fullest
+{
+	static constexpr lida::ChunkEngine chunk_engine = lida::ChunkEngine::bitmap;
+};
+
+template<typename Traits>
+lida::PoolStatistics churn()
+{
+	lida::MemoryPool<long, 0, Traits> pool;
+	std::vector<long*> objects;
+	std::mt19937 rng(3);
+	for (int i = 0; i < 20000; i++)
+		objects.push_back(pool.allocate(1));
+	for (int i = 0; i < 100000; i++)
+	{
+		if (rng() % 2 && !objects.empty())
+		{
+			auto j = rng() % objects.size();
+			std::swap(objects[j], objects.back());
+			pool.deallocate(objects.back(), 1);
+			objects.pop_back();
+		}
+		else
+			objects.push_back(pool.allocate(1));
+	}
+	for (std::size_t i = 0; i < objects.size(); i++)
+		*objects[i] = long(i);
+	for (std::size_t i = 0; i < objects.size(); i++)
+		LIDA_CHECK(*objects[i] == long(i));
+	auto stats = pool.statistics();
+	LIDA_CHECK(stats.live_objects == objects.size());
+	for (auto ptr : objects)
+		pool.deallocate(ptr, 1);
+	LIDA_CHECK(pool.statistics().chunks == 0);
+	return stats;
+}
+
+int main()
+{
+	auto lifo = churn<Lifo>();
+	auto fullest = churn<Fullest>();
+	churn<FullestBitmap>();
+	LIDA_CHECK(fullest.partial_chunks <= lifo.partial_chunks);
+
+	std::map<int, int, std::less<int>, lida::MemoryPool<std::pair<const int, int>, 0, Fullest>> map;
+	for (int i = 0; i < 10000; i++)
+		map[i] = i;
+	for (int i = 0; i < 10000; i += 3)
+		map.erase(i);
+	LIDA_CHECK(map.size() == 6666 && map.at(1) == 1);
+}
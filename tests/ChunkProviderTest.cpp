@@ -0,0 +1,65 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include <lida/ChunkProviders.hpp>
+
+#include "Check.hpp"
+
+/*
+ * Chunks of MmapChunkProvider are aligned in every huge page mode and
+ * `MAP_HUGETLB` chunks give their huge pages back when deallocated.
+ */
+
+static long free_huge_pages()
+{
+	std::ifstream meminfo("/proc/meminfo");
+	std::string key;
+	long value;
+	while (meminfo >> key >> value)
+	{
+		if (key == "HugePages_Free:")
+			return value;
+		std::getline(meminfo, key);
+	}
+	return 0;
+}
+
+template<lida::HugePages Mode>
+static void check_chunks()
+{
+	lida::MmapChunkProvider<Mode> provider;
+	for (std::size_t align = 4096; align <= 2 * lida::huge_page_size; align *= 4)
+		for (std::size_t size : {align, lida::huge_page_size, 2 * lida::huge_page_size})
+		{
+			auto chunk = provider.allocate(size, align);
+			LIDA_CHECK(reinterpret_cast<std::uintptr_t>(chunk) % align == 0);
+			std::memset(chunk, 0xAB, size);
+			provider.deallocate(chunk, size, align);
+		}
+}
+
+int main()
+{
+	auto huge_pages = free_huge_pages();
+	check_chunks<lida::HugePages::none>();
+	check_chunks<lida::HugePages::transparent>();
+	check_chunks<lida::HugePages::hugetlb>();
+	LIDA_CHECK(free_huge_pages() == huge_pages);
+}
@@ -0,0 +1,137 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <iterator>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <lida/Compaction.hpp>
+
+#include "Check.hpp"
+
+/*
+ * Compaction of lists and intrusive structures, limited to one group of
+ * global storages.
+ */
+
+struct Traits : lida::DefaultPoolTraits
+{
+	static constexpr std::size_t chunk_size = 4096;
+	static constexpr std::size_t retained_chunks = 0;
+};
+
+struct Node
+{
+	Node* next;
+	std::string name;
+};
+
+template<typename List>
+void thin_out(List& list, int keep_every)
+{
+	int i = 0;
+	for (auto it = list.begin(); it != list.end(); i++)
+		it = (i % keep_every) ? list.erase(it) : std::next(it);
+}
+
+int main()
+{
+	{
+		std::list<std::string, lida::MemoryPool<std::string, 0, Traits>> list;
+		for (int i = 0; i < 20000; i++)
+			list.push_back(std::to_string(i));
+		thin_out(list, 10);
+
+		// a sparse storage of another group stays as it is
+		lida::MemoryPool<long, 1, Traits> other;
+		std::vector<long*> all, kept;
+		for (int i = 0; i < 20000; i++)
+			all.push_back(other.allocate(1));
+		for (int i = 0; i < 20000; i++)
+			if (i % 10)
+				other.deallocate(all[i], 1);
+			else
+				kept.push_back(all[i]);
+		auto other_sparse = other.sparse_chunks(0.5);
+		LIDA_CHECK(other_sparse > 0);
+
+		LIDA_CHECK(lida::compact(list) > 0);
+		LIDA_CHECK(other.sparse_chunks(0.5) == other_sparse);
+		int i = 0;
+		for (auto& name : list)
+		{
+			LIDA_CHECK(name == std::to_string(i));
+			i += 10;
+		}
+		LIDA_CHECK(list.size() == 2000);
+		for (auto ptr : kept)
+			other.deallocate(ptr, 1);
+	}
+
+	{
+		lida::MemoryPoolResource resource;
+		std::list<int, lida::MemoryPool<int, 0, Traits>> list{lida::MemoryPool<int, 0, Traits>(resource)};
+		for (int i = 0; i < 20000; i++)
+			list.push_back(i);
+		thin_out(list, 20);
+		LIDA_CHECK(lida::compact(list, 0.3) > 0);
+		int i = 0;
+		for (auto value : list)
+		{
+			LIDA_CHECK(value == i);
+			i += 20;
+		}
+	}
+
+	{
+		lida::MemoryPool<Node, 0, Traits> pool;
+		Node* head = nullptr;
+		std::vector<Node*> nodes;
+		for (int i = 0; i < 5000; i++)
+			nodes.push_back(new(pool.allocate(1)) Node{nullptr, std::to_string(i)});
+		for (int i = 0; i < 5000; i++)
+			if (i % 7)
+			{
+				nodes[i]->~Node();
+				pool.deallocate(nodes[i], 1);
+			}
+			else
+			{
+				nodes[i]->next = head;
+				head = nodes[i];
+			}
+		auto sparse = pool.sparse_chunks(0.5);
+		LIDA_CHECK(sparse > 1);
+		{
+			lida::Compaction compaction(pool);
+			LIDA_CHECK(compaction.evacuated_chunks() > 0);
+			for (Node** link = &head; *link; link = &(*link)->next)
+				*link = lida::relocate(pool, *link);
+		}
+		// only the last chunk objects were moved to may stay sparse
+		LIDA_CHECK(pool.sparse_chunks(0.5) <= 1);
+		int count = 0;
+		for (auto node = head; node; count++)
+		{
+			auto next = node->next;
+			LIDA_CHECK(std::stoi(node->name) % 7 == 0);
+			node->~Node();
+			pool.deallocate(node, 1);
+			node = next;
+		}
+		LIDA_CHECK(count == 715);
+	}
+}
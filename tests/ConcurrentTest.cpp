@@ -0,0 +1,137 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <lida/ConcurrentMemoryPool.hpp>
+
+#include "Check.hpp"
+
+/*
+ * ConcurrentMemoryPool: objects of several threads, objects freed on
+ * other threads than the ones which allocated them, containers which
+ * allocate arrays, counts whose byte size overflows and equality.
+ */
+
+struct SmallBatches : lida::DefaultPoolTraits
+{
+	static constexpr std::size_t thread_cache_batch = 4;
+};
+
+int main()
+{
+	constexpr int threads = 4;
+	constexpr int count = 100'000;
+
+	{
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; t++)
+			workers.emplace_back([t]
+			{
+				std::set<int, std::less<int>, lida::ConcurrentMemoryPool<int>> set;
+				for (int i = 0; i < count; i++)
+					set.insert(i * threads + t);
+				LIDA_CHECK(set.size() == count);
+				int expected = t;
+				for (int value : set)
+				{
+					LIDA_CHECK(value == expected);
+					expected += threads;
+				}
+			});
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	{
+		// producers allocate, consumers free: every batch goes through the
+		// stack of remote frees and is reused by the producers
+		using Pool = lida::ConcurrentMemoryPool<long, 1, SmallBatches>;
+		std::mutex mutex;
+		std::vector<long*> queue;
+		std::atomic<int> producing = threads / 2;
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads / 2; t++)
+			workers.emplace_back([&, t]
+			{
+				Pool pool;
+				for (int i = 0; i < count; i++)
+				{
+					auto object = pool.allocate(1);
+					*object = long(t) * count + i;
+					std::lock_guard lock(mutex);
+					queue.push_back(object);
+				}
+				producing--;
+			});
+		std::vector<std::vector<bool>> seen(threads / 2, std::vector<bool>(count));
+		for (int t = 0; t < threads / 2; t++)
+			workers.emplace_back([&]
+			{
+				Pool pool;
+				std::vector<long*> taken;
+				while (true)
+				{
+					bool done = producing == 0;
+					{
+						std::lock_guard lock(mutex);
+						taken.swap(queue);
+						for (auto object : taken)
+						{
+							LIDA_CHECK(!seen[*object / count][*object % count]);
+							seen[*object / count][*object % count] = true;
+						}
+					}
+					for (auto object : taken)
+						pool.deallocate(object, 1);
+					if (done && taken.empty())
+						break;
+					taken.clear();
+				}
+			});
+		for (auto& worker : workers)
+			worker.join();
+		for (auto& producer : seen)
+			for (bool value : producer)
+				LIDA_CHECK(value);
+		// caches of finished threads were flushed, shrinking gives the
+		// stack of remote frees back to the storage
+		Pool::shrink_to_fit();
+		LIDA_CHECK(Pool::statistics().live_objects == 0);
+	}
+
+	{
+		std::vector<double, lida::ConcurrentMemoryPool<double>> vector;
+		for (int i = 0; i < count; i++)
+			vector.push_back(i);
+		LIDA_CHECK(vector.size() == count);
+		for (int i = 0; i < count; i++)
+			LIDA_CHECK(vector[i] == i);
+	}
+
+	LIDA_CHECK((lida::ConcurrentMemoryPool<int>() == lida::ConcurrentMemoryPool<long>()));
+	LIDA_CHECK((lida::ConcurrentMemoryPool<int, 0>() != lida::ConcurrentMemoryPool<int, 1>()));
+	LIDA_CHECK((lida::ConcurrentMemoryPool<int>() != lida::ConcurrentMemoryPool<int, 0, SmallBatches>()));
+
+	lida::ConcurrentMemoryPool<int> pool;
+	LIDA_CHECK_THROWS(pool.allocate(std::size_t(-1) / 2), std::bad_alloc);
+	pool.deallocate(pool.allocate(3), 3);
+}
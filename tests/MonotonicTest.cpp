@@ -0,0 +1,88 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <new>
+#include <vector>
+
+#include <lida/MonotonicPool.hpp>
+
+#include "Check.hpp"
+
+/*
+ * MonotonicPool: containers torn down together, reuse of blocks after
+ * reset(), allocations bigger than a block, alignment and equality.
+ */
+
+struct alignas(128) Aligned
+{
+	char bytes[128];
+};
+
+struct SmallBlocks : lida::DefaultPoolTraits
+{
+	static constexpr std::size_t chunk_size = 4096;
+};
+
+int main()
+{
+	using Pool = lida::MonotonicPool<int, 0, SmallBlocks>;
+
+	int* first = nullptr;
+	for (int round = 0; round < 3; round++)
+	{
+		{
+			std::list<int, Pool> list;
+			std::vector<int, Pool> vector;
+			for (int i = 0; i < 10'000; i++)
+			{
+				list.push_back(i);
+				vector.push_back(i);
+			}
+			int i = 0;
+			for (int value : list)
+				LIDA_CHECK(value == i++);
+			for (i = 0; i < 10'000; i++)
+				LIDA_CHECK(vector[i] == i);
+		}
+		// reset() reuses blocks from the start
+		auto object = Pool::allocate(1);
+		if (round == 0)
+			first = object;
+		LIDA_CHECK(object == first);
+		Pool::reset();
+	}
+	Pool::release();
+
+	{
+		lida::MonotonicPool<Aligned, 0, SmallBlocks> pool;
+		for (std::size_t n = 1; n < 100; n += 9)
+		{
+			auto array = pool.allocate(n);
+			LIDA_CHECK(reinterpret_cast<std::uintptr_t>(array) % alignof(Aligned) == 0);
+			array[n - 1].bytes[127] = 1;
+		}
+		pool.release();
+	}
+
+	LIDA_CHECK((lida::MonotonicPool<int>() == lida::MonotonicPool<long>()));
+	LIDA_CHECK((lida::MonotonicPool<int, 0>() != lida::MonotonicPool<int, 1>()));
+	LIDA_CHECK((lida::MonotonicPool<int>() != Pool()));
+
+	LIDA_CHECK_THROWS(Pool::allocate(std::size_t(-1) / 2), std::bad_alloc);
+	LIDA_CHECK_THROWS(Pool::allocate(std::size_t(-1) / sizeof(int)), std::bad_alloc);
+}
@@ -0,0 +1,84 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstddef>
+#include <list>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <lida/NumaMemoryPool.hpp>
+
+#include "Check.hpp"
+
+/*
+ * NumaMemoryPool: objects freed by other threads than the ones which
+ * allocated them, containers which allocate arrays, counts whose byte
+ * size overflows and equality.
+ */
+
+struct SmallBatches : lida::NumaPoolTraits
+{
+	static constexpr std::size_t thread_cache_batch = 4;
+};
+
+int main()
+{
+	constexpr int threads = 4;
+	constexpr int count = 100'000;
+
+	{
+		// every thread fills a list, the next thread empties it
+		using List = std::list<int, lida::NumaMemoryPool<int>>;
+		std::vector<List> lists(threads);
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; t++)
+			workers.emplace_back([&lists, t]
+			{
+				for (int i = 0; i < count; i++)
+					lists[t].push_back(t * count + i);
+			});
+		for (auto& worker : workers)
+			worker.join();
+		workers.clear();
+		for (int t = 0; t < threads; t++)
+			workers.emplace_back([&lists, t]
+			{
+				auto& list = lists[(t + 1) % threads];
+				int expected = (t + 1) % threads * count;
+				for (int value : list)
+					LIDA_CHECK(value == expected++);
+				list.clear();
+			});
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	{
+		std::vector<double, lida::NumaMemoryPool<double>> vector;
+		for (int i = 0; i < count; i++)
+			vector.push_back(i);
+		for (int i = 0; i < count; i++)
+			LIDA_CHECK(vector[i] == i);
+	}
+
+	LIDA_CHECK((lida::NumaMemoryPool<int>() == lida::NumaMemoryPool<long>()));
+	LIDA_CHECK((lida::NumaMemoryPool<int, 0>() != lida::NumaMemoryPool<int, 1>()));
+	LIDA_CHECK((lida::NumaMemoryPool<int>() != lida::NumaMemoryPool<int, 0, SmallBatches>()));
+
+	lida::NumaMemoryPool<int> pool;
+	LIDA_CHECK_THROWS(pool.allocate(std::size_t(-1) / 2), std::bad_alloc);
+	pool.deallocate(pool.allocate(3), 3);
+}
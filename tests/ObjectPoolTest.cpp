@@ -0,0 +1,100 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <lida/ObjectPool.hpp>
+
+#include "Check.hpp"
+
+/*
+ * ObjectPool: construction and destruction of objects, stale handles of
+ * destroyed objects and of reused slots, clear() and generation wrap.
+ */
+
+struct Counted
+{
+	static inline int alive = 0;
+	std::string name;
+
+	explicit Counted(std::string name)
+		: name(std::move(name))
+	{
+		alive++;
+	}
+	~Counted()
+	{
+		alive--;
+	}
+};
+
+struct TwoBits : lida::DefaultPoolTraits
+{
+	static constexpr std::size_t handle_generation_bits = 2;
+};
+
+int main()
+{
+	{
+		lida::ObjectPool<Counted> pool;
+		std::vector<lida::ObjectHandle> handles;
+		for (int i = 0; i < 10'000; i++)
+			handles.push_back(pool.create_handle(std::to_string(i)));
+		LIDA_CHECK(Counted::alive == 10'000 && pool.size() == 10'000);
+		for (int i = 0; i < 10'000; i++)
+			LIDA_CHECK(pool.get(handles[i])->name == std::to_string(i));
+
+		// a destroyed object's handle is stale, also after its slot is reused
+		auto stale = handles[42];
+		LIDA_CHECK(pool.destroy(stale));
+		LIDA_CHECK(pool.get(stale) == nullptr);
+		LIDA_CHECK(!pool.destroy(stale));
+		auto reused = pool.create_handle("reused");
+		LIDA_CHECK(reused != stale);
+		LIDA_CHECK(pool.get(stale) == nullptr);
+		LIDA_CHECK(pool.get(reused)->name == "reused");
+		LIDA_CHECK(pool.handle_of(pool.get(reused)) == reused);
+		LIDA_CHECK(pool.get(lida::ObjectHandle{}) == nullptr);
+
+		pool.clear();
+		LIDA_CHECK(Counted::alive == 0 && pool.size() == 0);
+		for (auto handle : handles)
+			LIDA_CHECK(pool.get(handle) == nullptr);
+		LIDA_CHECK(pool.get(reused) == nullptr);
+
+		auto object = pool.create("again");
+		LIDA_CHECK(pool.get(pool.handle_of(object)) == object);
+	}
+	LIDA_CHECK(Counted::alive == 0);
+
+	{
+		// the generation counts objects of the slot and wraps after 1 << bits
+		lida::ObjectPool<int, TwoBits> pool;
+		auto first = pool.create_handle(0);
+		pool.destroy(first);
+		for (int i = 1; i < 4; i++)
+		{
+			auto handle = pool.create_handle(i);
+			LIDA_CHECK(handle != first);
+			LIDA_CHECK(pool.get(first) == nullptr);
+			pool.destroy(handle);
+		}
+		auto wrapped = pool.create_handle(4);
+		LIDA_CHECK(wrapped == first);
+	}
+}
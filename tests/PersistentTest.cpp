@@ -0,0 +1,119 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <lida/OffsetPtr.hpp>
+#include <lida/PersistentPool.hpp>
+
+#include "Check.hpp"
+
+/*
+ * PersistentPool: containers written to a file are read back after the
+ * file is mapped at another address, files which aren't pools are rejected
+ * and OffsetPtr works as a pointer.
+ */
+
+template<typename T>
+using Alloc = lida::PersistentAllocator<T>;
+using Row = std::vector<int, Alloc<int>>;
+
+struct Root
+{
+	std::vector<Row, Alloc<Row>> rows;
+	lida::OffsetPtr<int> picked;
+
+	explicit Root(Alloc<int> allocator)
+		: rows(Alloc<Row>(allocator)) {}
+};
+
+int main()
+{
+	const char* path = "PersistentTest.data";
+	std::remove(path);
+
+	std::uintptr_t old_root;
+	{
+		lida::PersistentPool pool(path, 16 << 20);
+		LIDA_CHECK(pool.created());
+		auto& root = pool.root<Root>(pool.allocator<int>());
+		old_root = reinterpret_cast<std::uintptr_t>(&root);
+		for (int i = 0; i < 1000; i++)
+		{
+			Row row(pool.allocator<int>());
+			for (int j = 0; j <= i % 50; j++)
+				row.push_back(i * j);
+			root.rows.push_back(std::move(row));
+		}
+		root.picked = &root.rows[7][3];
+		pool.flush();
+	}
+
+	// occupy the page of the old root, so the file is mapped elsewhere
+	auto page = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+	auto blocker = mmap(reinterpret_cast<void*>(old_root & ~(page - 1)), page, PROT_NONE,
+						MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	LIDA_CHECK(blocker != MAP_FAILED);
+	{
+		lida::PersistentPool pool(path, 0);
+		LIDA_CHECK(!pool.created());
+		auto& root = pool.root<Root>(pool.allocator<int>());
+		LIDA_CHECK(reinterpret_cast<std::uintptr_t>(&root) != old_root);
+		LIDA_CHECK(root.rows.size() == 1000);
+		for (int i = 0; i < 1000; i++)
+		{
+			LIDA_CHECK(root.rows[i].size() == std::size_t(i % 50 + 1));
+			for (int j = 0; j <= i % 50; j++)
+				LIDA_CHECK(root.rows[i][j] == i * j);
+		}
+		LIDA_CHECK(*root.picked == 21);
+
+		// memory of freed objects is reused, rows of 9 to 16 values have
+		// capacity for 16
+		root.rows.erase(root.rows.begin() + 500, root.rows.end());
+		auto used = pool.used();
+		for (int i = 0; i < 50; i++)
+			root.rows.emplace_back(std::size_t(16), 1, pool.allocator<int>());
+		LIDA_CHECK(pool.used() == used);
+	}
+	munmap(blocker, page);
+	std::remove(path);
+
+	{
+		auto file = std::fopen(path, "w");
+		std::fputs("not a pool, but not empty either", file);
+		std::fclose(file);
+		LIDA_CHECK_THROWS(lida::PersistentPool(path, 0), std::runtime_error);
+		std::remove(path);
+	}
+
+	{
+		int array[4] = {1, 2, 3, 4};
+		lida::OffsetPtr<int> null;
+		lida::OffsetPtr<int> ptr = array;
+		lida::OffsetPtr<const int> to_const = ptr;
+		LIDA_CHECK(!null && null == nullptr);
+		LIDA_CHECK(ptr[2] == 3 && *(to_const + 3) == 4 && (ptr + 4) - ptr == 4);
+		lida::OffsetPtr<void> erased = ptr;
+		LIDA_CHECK(static_cast<lida::OffsetPtr<int>>(erased) == ptr);
+	}
+}
@@ -0,0 +1,103 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include <lida/PmrPoolResource.hpp>
+
+#include "Check.hpp"
+
+/*
+ * PmrPoolResource: pmr containers, alignment of size classes, requests
+ * passed to the upstream resource and equality.
+ */
+
+// upstream which counts bytes it currently holds
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+	std::size_t bytes = 0;
+
+protected:
+	void* do_allocate(std::size_t size, std::size_t alignment) override
+	{
+		bytes += size;
+		return std::pmr::new_delete_resource()->allocate(size, alignment);
+	}
+
+	void do_deallocate(void* ptr, std::size_t size, std::size_t alignment) override
+	{
+		bytes -= size;
+		std::pmr::new_delete_resource()->deallocate(ptr, size, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+};
+
+int main()
+{
+	using Resource = lida::PmrPoolResource<>;
+
+	CountingResource upstream;
+	{
+		Resource resource(&upstream);
+		LIDA_CHECK(resource.upstream_resource() == &upstream);
+		{
+			std::pmr::map<int, std::pmr::string> map(&resource);
+			for (int i = 0; i < 10'000; i++)
+				map.emplace(i, std::string(std::size_t(i % 64), 'a'));
+			for (auto& [key, value] : map)
+				LIDA_CHECK(value.size() == std::size_t(key % 64));
+		}
+		LIDA_CHECK(upstream.bytes == 0);
+
+		for (std::size_t alignment = 1; alignment <= 64; alignment *= 2)
+			for (std::size_t bytes = 1; bytes <= Resource::max_block; bytes = bytes * 3 / 2 + 1)
+			{
+				auto ptr = resource.allocate(bytes, alignment);
+				LIDA_CHECK(reinterpret_cast<std::uintptr_t>(ptr) % alignment == 0);
+				resource.deallocate(ptr, bytes, alignment);
+			}
+		LIDA_CHECK(upstream.bytes == 0);
+
+		// too big or over-aligned requests go upstream
+		auto big = resource.allocate(Resource::max_block + 1, 8);
+		auto aligned = resource.allocate(64, 128);
+		LIDA_CHECK(upstream.bytes == Resource::max_block + 1 + 64);
+		LIDA_CHECK(reinterpret_cast<std::uintptr_t>(aligned) % 128 == 0);
+		resource.deallocate(big, Resource::max_block + 1, 8);
+		resource.deallocate(aligned, 64, 128);
+		LIDA_CHECK(upstream.bytes == 0);
+
+		Resource other;
+		LIDA_CHECK(resource.is_equal(resource) && !resource.is_equal(other));
+
+		// release() frees every block at once, the resource stays usable
+		for (int i = 0; i < 1000; i++)
+			(void)resource.allocate(24, 8);
+		resource.release();
+		std::pmr::vector<int> vector(&resource);
+		vector.assign(100, 2);
+		LIDA_CHECK(vector[99] == 2);
+	}
+}
@@ -0,0 +1,108 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cstddef>
+#include <future>
+#include <vector>
+
+#include <lida/ChunkProviders.hpp>
+#include <lida/MemoryPool.hpp>
+
+#include "Check.hpp"
+
+/*
+ * reserve_async() with providers which populate pages in the background,
+ * which refuse to and which can't.
+ */
+
+// populate() of a kernel without MADV_POPULATE_WRITE
+struct RefusingProvider : lida::NewChunkProvider
+{
+	static inline std::size_t calls = 0;
+
+	bool populate(void*, std::size_t) noexcept
+	{
+		calls++;
+		return false;
+	}
+};
+
+struct Mmap : lida::DefaultPoolTraits
+{
+	using chunk_provider = lida::MmapChunkProvider<>;
+};
+
+struct Refusing : lida::DefaultPoolTraits
+{
+	using chunk_provider = RefusingProvider;
+};
+
+static bool ready(std::future<void>& future)
+{
+	return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+template<typename Traits>
+static void check_allocations(lida::MemoryPool<int, 0, Traits>& pool, std::size_t count)
+{
+	std::vector<int*> objects(count);
+	for (std::size_t i = 0; i < count; i++)
+		*(objects[i] = pool.allocate(1)) = int(i);
+	for (std::size_t i = 0; i < count; i++)
+	{
+		LIDA_CHECK(*objects[i] == int(i));
+		pool.deallocate(objects[i], 1);
+	}
+}
+
+int main()
+{
+	constexpr std::size_t count = 1'000'000;
+
+	{
+		lida::MemoryPoolResource resource;
+		lida::MemoryPool<int, 0, Mmap> pool(resource);
+		auto warm = pool.reserve_async(count);
+		// chunks may be allocated from while pages are being populated
+		check_allocations(pool, count / 2);
+		warm.wait();
+		check_allocations(pool, count);
+	}
+
+	{
+		lida::MemoryPoolResource resource;
+		lida::MemoryPool<int, 0, Refusing> pool(resource);
+		auto warm = pool.reserve_async(count);
+		LIDA_CHECK(ready(warm));
+		LIDA_CHECK(RefusingProvider::calls > 0);
+		check_allocations(pool, count);
+	}
+
+	{
+		lida::MemoryPoolResource resource;
+		lida::MemoryPool<int> pool(resource);
+		auto warm = pool.reserve_async(count);
+		LIDA_CHECK(ready(warm));
+		check_allocations(pool, count);
+	}
+
+	{
+		lida::MemoryPoolResource resource;
+		lida::MemoryPool<int, 0, Mmap> pool(resource);
+		auto warm = pool.reserve_async(0);
+		LIDA_CHECK(ready(warm));
+	}
+}
@@ -0,0 +1,76 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <list>
+#include <new>
+#include <vector>
+
+#include <lida/MemoryPool.hpp>
+
+#include "Check.hpp"
+
+/*
+ * Instance-scoped storages, their release and equality of allocators.
+ */
+
+struct Fixed : lida::DefaultPoolTraits
+{
+	static constexpr bool fixed_capacity = true;
+};
+
+int main()
+{
+	{
+		lida::MemoryPoolResource resource;
+		lida::MemoryPool<int> pool(resource);
+		{
+			std::list<int, lida::MemoryPool<int>> list(pool);
+			for (int i = 0; i < 1000; i++)
+				list.push_back(i);
+			LIDA_CHECK(list.size() == 1000);
+		}
+		(void)pool.allocate(1);
+		(void)pool.allocate(4);
+		resource.release();
+		LIDA_CHECK(pool.statistics().chunks == 0);
+		// the allocator keeps working after the release
+		auto ptr = pool.allocate(1);
+		*ptr = 1;
+		pool.deallocate(ptr, 1);
+		pool.deallocate(pool.allocate(4), 4);
+		LIDA_CHECK(pool.statistics().live_objects == 0);
+	}
+
+	{
+		lida::MemoryPoolResource resource;
+		LIDA_CHECK((lida::MemoryPool<int, 0>() == lida::MemoryPool<long, 0>()));
+		LIDA_CHECK((lida::MemoryPool<int, 0>() != lida::MemoryPool<int, 1>()));
+		LIDA_CHECK((lida::MemoryPool<int, 0>() != lida::MemoryPool<int, 0, Fixed>()));
+		LIDA_CHECK((lida::MemoryPool<int>(resource) == lida::MemoryPool<long>(resource)));
+		LIDA_CHECK((lida::MemoryPool<int>(resource) != lida::MemoryPool<int>()));
+	}
+
+	{
+		lida::MemoryPoolResource resource;
+		lida::MemoryPool<int, 0, Fixed> pool(resource);
+		pool.reserve(1000);
+		LIDA_CHECK_THROWS(pool.allocate(4), std::bad_alloc);
+		pool.reserve_arrays(4, 10);
+		std::vector<int, lida::MemoryPool<int, 0, Fixed>> vector(pool);
+		vector.reserve(4);
+		vector.assign(4, 1);
+		LIDA_CHECK(vector.size() == 4);
+	}
+}
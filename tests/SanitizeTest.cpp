@@ -0,0 +1,96 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <stdexcept>
+
+#include <lida/MemoryPool.hpp>
+
+#include "Check.hpp"
+
+/*
+ * Sanitize mode of both chunk engines reports double frees, pointers
+ * which don't point to a slot and writes to freed objects, in every build.
+ */
+
+struct Sanitized : lida::DefaultPoolTraits
+{
+	static constexpr bool sanitize = true;
+};
+
+struct SanitizedBitmap : Sanitized
+{
+	static constexpr lida::ChunkEngine chunk_engine = lida::ChunkEngine::bitmap;
+};
+
+template<typename Traits>
+static void check_errors()
+{
+	using Pool = lida::MemoryPool<long, 0, Traits>;
+
+	{
+		lida::MemoryPoolResource resource;
+		Pool pool(resource);
+		auto object = pool.allocate(1);
+		auto other = pool.allocate(1);
+		pool.deallocate(object, 1);
+		LIDA_CHECK_THROWS(pool.deallocate(object, 1), std::runtime_error);
+		pool.deallocate(other, 1);
+	}
+
+	{
+		lida::MemoryPoolResource resource;
+		Pool pool(resource);
+		auto object = pool.allocate(1);
+		auto inside = reinterpret_cast<long*>(reinterpret_cast<char*>(object) + 1);
+		LIDA_CHECK_THROWS(pool.deallocate(inside, 1), std::runtime_error);
+		pool.deallocate(object, 1);
+	}
+
+#ifndef LIDA_POOL_ASAN
+	// with AddressSanitizer the write itself is reported
+	{
+		lida::MemoryPoolResource resource;
+		Pool pool(resource);
+		auto object = pool.allocate(1);
+		pool.deallocate(object, 1);
+		std::memset(static_cast<void*>(object), 0, sizeof(long));
+		LIDA_CHECK_THROWS(pool.allocate(1), std::runtime_error);
+	}
+#endif
+
+	{
+		// correct use doesn't report anything
+		lida::MemoryPoolResource resource;
+		Pool pool(resource);
+		long* objects[1000];
+		for (int round = 0; round < 3; round++)
+		{
+			for (auto& object : objects)
+				*(object = pool.allocate(1)) = round;
+			for (auto object : objects)
+			{
+				LIDA_CHECK(*object == round);
+				pool.deallocate(object, 1);
+			}
+		}
+	}
+}
+
+int main()
+{
+	check_errors<Sanitized>();
+	check_errors<SanitizedBitmap>();
+}
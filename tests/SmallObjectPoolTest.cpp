@@ -0,0 +1,82 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <new>
+#include <vector>
+
+#include <lida/SmallObjectPool.hpp>
+
+#include "Check.hpp"
+
+/*
+ * SmallObjectPool: types of many sizes sharing size classes, arrays in
+ * and above the classes, alignment and equality.
+ */
+
+struct alignas(64) Aligned
+{
+	char bytes[64];
+};
+
+struct Other : lida::DefaultPoolTraits
+{
+	static constexpr std::size_t chunk_size = 64 * 1024;
+};
+
+int main()
+{
+	{
+		std::list<int, lida::SmallObjectPool<int>> list;
+		std::map<int, double, std::less<int>, lida::SmallObjectPool<std::pair<const int, double>>> map;
+		std::vector<long, lida::SmallObjectPool<long>> vector;
+		for (int i = 0; i < 10'000; i++)
+		{
+			list.push_back(i);
+			map.emplace(i, i * 0.5);
+			vector.push_back(i);
+		}
+		int i = 0;
+		for (int value : list)
+			LIDA_CHECK(value == i++);
+		for (auto& [key, value] : map)
+			LIDA_CHECK(value == key * 0.5);
+		for (i = 0; i < 10'000; i++)
+			LIDA_CHECK(vector[i] == i);
+	}
+	LIDA_CHECK(lida::SmallObjectPool<int>::statistics().live_objects == 0);
+
+	{
+		lida::SmallObjectPool<Aligned> pool;
+		std::vector<Aligned*> objects;
+		for (std::size_t n = 1; n < 20; n++)
+			objects.push_back(pool.allocate(n));
+		for (auto object : objects)
+			LIDA_CHECK(reinterpret_cast<std::uintptr_t>(object) % alignof(Aligned) == 0);
+		for (std::size_t n = 1; n < 20; n++)
+			pool.deallocate(objects[n - 1], n);
+	}
+
+	LIDA_CHECK((lida::SmallObjectPool<int>() == lida::SmallObjectPool<double>()));
+	LIDA_CHECK((lida::SmallObjectPool<int, 0>() != lida::SmallObjectPool<int, 1>()));
+	LIDA_CHECK((lida::SmallObjectPool<int>() != lida::SmallObjectPool<int, 0, Other>()));
+
+	lida::SmallObjectPool<int> pool;
+	LIDA_CHECK_THROWS(pool.allocate(std::size_t(-1) / 2), std::bad_alloc);
+	LIDA_CHECK(lida::SmallObjectPool<int>::statistics().live_objects == 0);
+}
@@ -0,0 +1,77 @@
+/*
+Copyright 2021 Adil Mokhammad
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstddef>
+#include <vector>
+
+#include <lida/ChunkProviders.hpp>
+#include <lida/MemoryPool.hpp>
+
+#include "Check.hpp"
+
+/*
+ * trim(), shrink_to_fit() and release_free_memory() of cached free chunks.
+ */
+
+struct Mmap : lida::DefaultPoolTraits
+{
+	using chunk_provider = lida::MmapChunkProvider<>;
+};
+
+int main()
+{
+	constexpr std::size_t count = 100'000;
+
+	{
+		lida::MemoryPoolResource resource;
+		lida::MemoryPool<int> pool(resource);
+		pool.reserve(count);
+		auto stats = pool.statistics();
+		LIDA_CHECK(stats.free_chunks == stats.chunks && stats.chunks > 2);
+		auto chunk = stats.bytes / stats.chunks;
+
+		LIDA_CHECK(pool.trim(stats.bytes) == 0);
+		LIDA_CHECK(pool.trim(chunk) == stats.bytes - chunk);
+		LIDA_CHECK(pool.statistics().free_chunks == 1);
+		pool.shrink_to_fit();
+		LIDA_CHECK(pool.statistics().chunks == 0);
+		pool.deallocate(pool.allocate(1), 1);
+	}
+
+	{
+		// pages of free mmap chunks are discarded, the chunks stay cached
+		lida::MemoryPool<int, 0, Mmap> pool;
+		pool.reserve(count);
+		auto stats = pool.statistics();
+		auto discarded = lida::release_free_memory();
+		LIDA_CHECK(discarded > 0 && discarded < stats.bytes);
+		LIDA_CHECK(pool.statistics().free_chunks == stats.free_chunks);
+		// nothing is discarded twice
+		LIDA_CHECK(lida::release_free_memory() == 0);
+
+		std::vector<int*> objects(count);
+		for (std::size_t i = 0; i < count; i++)
+			*(objects[i] = pool.allocate(1)) = int(i);
+		for (std::size_t i = 0; i < count; i++)
+			LIDA_CHECK(*objects[i] == int(i));
+		for (auto object : objects)
+			pool.deallocate(object, 1);
+		// chunks used since the last call are discarded again
+		auto again = lida::release_free_memory();
+		LIDA_CHECK(again > 0 && again <= discarded);
+		LIDA_CHECK(lida::release_free_memory() == 0);
+		pool.deallocate(pool.allocate(1), 1);
+	}
+}